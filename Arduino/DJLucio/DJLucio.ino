@@ -21,35 +21,66 @@
 #include <NintendoExtensionCtrl.h>
 
 // User Settings
-const int8_t HorizontalSens = 5;  // Mouse sensitivity multipler - 6 max
-const int8_t VerticalSens   = 2;  // Mouse sensitivity multipler - 6 max
-const int8_t MaxAimInput = 20;    // Ignore aim values above this threshold as extranous
+constexpr float HorizontalSens = 5.0;  // Mouse sensitivity multipler, fractions allowed - 127 max (less with acceleration)
+constexpr float VerticalSens   = 2.0;  // Mouse sensitivity multipler, fractions allowed - 127 max (less with acceleration)
+const uint8_t AimAcceleration = 0;    // Extra sensitivity per count above the threshold, in percent (0 = off)
+const uint8_t AimAccelThreshold = 4;  // Turntable speed where the acceleration starts, in counts per poll
+const int8_t MaxAimInput = 20;    // Check aim values above this threshold for spurious readings
+const int8_t MaxAimJump = 10;     // Aim values above MaxAimInput that jump more than this from the recent trend are ignored as extraneous
+const int8_t FastPollInput = 12;  // Poll faster when aim values reach this threshold, to avoid hitting the max
+const uint8_t FineAimShift = 2;   // With FUSED_AIM, alt platter speed as a fraction of the main: 1/2^N. 0 adds both at full speed
 
 // Tuning Options
 const unsigned long UpdateRate = 4;          // Controller polling rate, in milliseconds (ms)
+const unsigned long FastUpdateRate = 1;      // Controller polling rate when the turntable is spinning quickly (ms)
+const unsigned long IdleUpdateRate = 8;      // Controller polling rate when the controller is idle (ms)
+const unsigned long IdleTimeout = 2000;      // Time without new inputs before the controller is considered idle (ms)
 const unsigned long DetectTime = 1000;       // Time before a connected controller is considered stable (ms)
-const unsigned long ConnectRate = 500;       // Rate to attempt reconnections, in ms
+const unsigned long FastConnectRate = 10;    // Time before the first reconnection attempt, doubles for each failure (ms)
+const unsigned long ConnectRate = 500;       // Max time between reconnection attempts, in ms
+const uint32_t      I2C_Clock = 400000;      // I2C bus speed, in Hz. Use 100000 for controllers that don't support fast mode
 const unsigned long ConfigThreshold = 3000;  // Time the euphoria and green buttons must be held to set a new config (ms)
 const unsigned long EffectsTimeout = 1200;   // Timeout for the effects tracker, in ms
 const uint8_t       EffectThreshold = 10;    // Threshold to trigger abilities from the fx dial, 10 = 1/3rd of a revolution
+const unsigned long EffectFlickTime = 80;    // Turning the fx dial half the threshold within this time triggers abilities early, in ms. 0 to disable
+const uint8_t       MuxAddress = 0x70;       // With CONTROLLER_MUX, I2C address of the TCA9548A multiplexer
+const unsigned long SwitchTime = 1000;       // With CONTROLLER_MUX, time the active controller must be idle before another can take over (ms)
 // #define IGNORE_DETECT_PIN                 // Ignore the state of the 'controller detect' pin, for breakouts without one.
+// #define AIM_PREDICTION                    // Estimate the aim motion between controller polls, for smoother 1 ms mouse output
+// #define FUSED_AIM                         // With two turntables, aim horizontally with both: main at full speed, alt for fine adjustment
+// #define JOY_PULSE                         // Pulse the movement keys in proportion to how far the joystick is pushed, for partial speed
+// #define GAMEPAD                           // Send the controls as a gamepad with analog axes, instead of a keyboard and mouse
+// #define DISABLE_SLEEP                     // Keep the CPU running between controller polls instead of idling
+// #define CONTROLLER_MUX                    // Several controllers on a TCA9548A I2C multiplexer, one per channel. See 'stations' below
 
 // Debug Flags (uncomment to add)
-// #define DEBUG                // Enable to use any prints
+// #define DEBUG                // Enable to use any prints. Sent as binary, decode with Host/build/log-decode
 // #define DEBUG_RAW            // See the raw data from the turntable
+// #define DEBUG_CAPTURE        // Stream the raw data in a compact binary format, see DJLucio_Capture.h (not with DEBUG)
 // #define DEBUG_HID            // See HID inputs as they're pressed/released
 // #define DEBUG_COMMS          // Follow the controller connect and update calls
 // #define DEBUG_CONTROLDETECT  // Trace the controller detect pin functions
 // #define DEBUG_CONFIG         // Debug the config read/set functionality
+// #define DEBUG_PERFORMANCE    // Report loop rate, HID rate, and input-to-HID latency once per second
+// #define DEBUG_PROFILE        // Time each part of the loop, send 'p' over serial to print the results
+// #define DEBUG_MEMORY         // Print the RAM used by each part of the program at startup
 
 // ---------------------------------------------------------------------------
 
 #include "DJLucio_LED.h"   // LED handling classes
+#include "DJLucio_Performance.h"  // Loop timing and latency measurements (debug)
 #include "DJLucio_HID.h"   // HID classes (Keyboard, Mouse)
+#include "DJLucio_Aim.h"   // Turntable to mouse scaling
 #include "DJLucio_Controller.h"  // Turntable connection and data helper classes
 #include "DJLucio_ConfigMode.h"  // Configuration mode (left/right) switching class
+#include "DJLucio_Mapping.h"  // Input to HID mapping layouts
 
-DJTurntableController dj;
+static_assert(ConfigThreshold <= Ticks<TimerTick>::Limit && DetectTime <= Ticks<TimerTick>::Limit
+	&& EffectsTimeout <= Ticks<TimerTick>::Limit && ConnectRate <= Ticks<TimerTick>::Limit,
+	"Time setting is too long for the timers, see 'TimerTick' in DJLucio_Util.h");
+
+ExtensionData djData;  // Control data, shared with the background reader
+DJTurntableController dj(djData);
 
 DJTurntableController::TurntableExpansion * mainTable = &dj.right;
 DJTurntableController::TurntableExpansion * altTable = &dj.left;
@@ -70,9 +101,145 @@ KeyboardButton moveBack('s');
 KeyboardButton moveRight('d');
 KeyboardButton jump(' ');
 
-EffectHandler fx(dj, EffectsTimeout);
+typedef AccelerationCurve<AimAcceleration, AimAccelThreshold> AimCurve;
+static_assert(AimAxis<AimCurve>::validSensitivity(HorizontalSens) && AimAxis<AimCurve>::validSensitivity(VerticalSens),
+	"Your sensitivity is too high! Lower it, or the acceleration");
+AimAxis<AimCurve> aimX(HorizontalSens);
+AimAxis<AimCurve> aimY(VerticalSens);
+AimFilter filterX(MaxAimInput, MaxAimJump);
+AimFilter filterY(MaxAimInput, MaxAimJump);
+
+#ifdef AIM_PREDICTION
+AimPredictor predictX;
+AimPredictor predictY;
+boolean aimed = false;  // Whether this poll sent aim motion
+#endif
+
+EffectHandler fx(dj, EffectsTimeout, EffectFlickTime);
+
+PollScheduler poller(UpdateRate, FastUpdateRate, IdleUpdateRate, IdleTimeout);
+#ifdef CONTROLLER_MUX
+// One per multiplexer channel, starting at channel 0, each with its own detect pin
+ControllerStation stations[] = {
+	{ DetectPin, poller, DetectTime, FastConnectRate, ConnectRate },
+	{ DetectPin2, poller, DetectTime, FastConnectRate, ConnectRate },
+};
+static_assert(DetectPin2 != SDA_Pin && DetectPin2 != SCL_Pin && DetectPin2 != DetectPin,
+	"The second detect pin can't share a pin with the bus or the first controller!");
+const uint8_t NumStations = sizeof(stations) / sizeof(stations[0]);
+
+I2CMux<> mux(Wire, MuxAddress);
+ControllerGroup<NumStations> controller(mux, stations, djData, SwitchTime);
+#else
+ConnectionHelper controller(dj, djData, DetectPin, poller, DetectTime, FastConnectRate, ConnectRate);
+#endif
+
+// --Input Mapping--
+using namespace Mapping;
+
+typedef DJTurntableController DJ;
+typedef DJTurntableController::TurntableExpansion Table;
+
+typedef BaseButton<&DJ::buttonMinus> AimSelect;  // Disables aiming (dual) or selects vertical (single)
+
+const uint8_t JoyCenter = 32;
+const uint8_t JoyDeadzone = 6;  // Radius, centered at 32 in (0-63)
+const uint8_t JoyPulseFrames = 8;  // Length of a movement pulse, in USB frames (ms). Power of 2.
+
+typedef Stick<JoyX, JoyY, JoyCenter, JoyDeadzone> Joystick;
+
+#ifdef JOY_PULSE
+template<class Direction> using Move = Pulse<Direction, JoyPulseFrames>;
+#else
+template<class Direction> using Move = Direction;
+#endif
+
+typedef Zones<Crossfader, 0, Edge<10, 2>> CrossfadeZones;  // Right of center (7/8) from 10, back below 8 to release
+
+typedef Layout<
+	// Aiming: main is horizontal, alt is vertical. Minus disables (for position correction)
+	Enable<Not<AimSelect>, Aim<MainPlatter, Vertical<AltPlatter>>>,
+
+	// Movement
+	Key<jump, MainButton<&Table::buttonRed>>,
+
+	// Weapons
+	Click<fire, AnyOf<MainButton<&Table::buttonGreen>, MainButton<&Table::buttonBlue>>>,  // Outside buttons
+	Click<boop, AnyOf<AltButton<&Table::buttonGreen>, AltButton<&Table::buttonRed>, AltButton<&Table::buttonBlue>>>
+> DualTurntables;
+
+typedef Sum<MainPlatter, Fine<AltPlatter, FineAimShift>> FusedPlatters;
+
+typedef Layout<
+	// Aiming: both platters are horizontal, or main is vertical while minus is held
+	Aim<Gate<Not<AimSelect>, FusedPlatters>, Gate<AimSelect, Vertical<MainPlatter>>>,
+
+	// Movement
+	Key<jump, MainButton<&Table::buttonRed>>,
+
+	// Weapons
+	Click<fire, AnyOf<MainButton<&Table::buttonGreen>, MainButton<&Table::buttonBlue>>>,  // Outside buttons
+	Click<boop, AnyOf<AltButton<&Table::buttonGreen>, AltButton<&Table::buttonRed>, AltButton<&Table::buttonBlue>>>
+> FusedTurntables;
+
+typedef Layout<
+	// Aiming: horizontal, or vertical while minus is held
+	Aim<Gate<Not<AimSelect>, Platter>, Gate<AimSelect, Vertical<Platter>>>,
+
+	// Movement
+	Key<jump, BaseButton<&DJ::buttonRed>>,
+
+	// Weapons
+	Click<fire, BaseButton<&DJ::buttonGreen>>,
+	Click<boop, BaseButton<&DJ::buttonBlue>>
+> SingleTurntable;
+
+typedef Layout<
+	Key<moveLeft, Move<PushLeft<Joystick>>>,
+	Key<moveRight, Move<PushRight<Joystick>>>,
+	Key<moveForward, Move<PushUp<Joystick>>>,
+	Key<moveBack, Move<PushDown<Joystick>>>
+> Movement;
+
+typedef Layout<
+	// Movement
+	Joystick,
+	Movement,
+
+	// Weapons
+	Key<reload, EffectBackward<EffectThreshold>>,
+
+	// Abilities
+	Key<ultimate, BaseButton<&DJ::buttonEuphoria>>,
+	Key<amp, EffectForward<EffectThreshold>>,
+	Key<crossfade, InZone<CrossfadeZones, 1>>,
+
+	// Fun stuff!
+	Key<emotes, BaseButton<&DJ::buttonPlus>>
+> BaseStation;
+#ifdef GAMEPAD
+typedef Layout<
+	// Axes
+	PadAxis<HID_Gamepad::X, JoyX, 0, 63>,
+	PadAxis<HID_Gamepad::Y, JoyY, 63, 0>,  // Up is negative
+	PadAxis<HID_Gamepad::Z, Crossfader, 0, 15>,
+	PadAxis<HID_Gamepad::RX, MainPlatter, -31, 31>,
+	PadAxis<HID_Gamepad::RY, AltPlatter, -31, 31>,
+	PadAxis<HID_Gamepad::RZ, EffectDial, 0, 31>,
+
+	// Buttons
+	PadButton<0, MainButton<&Table::buttonGreen>>,
+	PadButton<1, MainButton<&Table::buttonRed>>,
+	PadButton<2, MainButton<&Table::buttonBlue>>,
+	PadButton<3, AltButton<&Table::buttonGreen>>,
+	PadButton<4, AltButton<&Table::buttonRed>>,
+	PadButton<5, AltButton<&Table::buttonBlue>>,
+	PadButton<6, BaseButton<&DJ::buttonEuphoria>>,
+	PadButton<7, BaseButton<&DJ::buttonMinus>>,
+	PadButton<8, BaseButton<&DJ::buttonPlus>>
+> Gamepad;
+#endif
 
-ConnectionHelper controller(dj, DetectPin, UpdateRate, DetectTime, ConnectRate);
 TurntableConfig config(dj, &DJTurntableController::buttonEuphoria, &DJTurntableController::TurntableExpansion::buttonGreen, ConfigThreshold);
 
 void setup() {
@@ -88,134 +255,178 @@ void setup() {
 	pinMode(SafetyPin, INPUT_PULLUP);
 	if (digitalRead(SafetyPin) == LOW) {
 		DEBUG_PRINTLN("Safety loop activated! Exiting program");
+		DEBUG_FLUSH();
 		for (;;);  // Safety loop!
 	}
 
+	D_CAPTURE(begin());  // Start serial for the raw data stream
+	D_PROFILER(begin());  // Start the profiler's clock
 	LED.begin();  // Set LED pin mode
+	HID_Report::begin();  // Start USB keyboard and mouse
+	#ifdef GAMEPAD
+	HID_Gamepad::begin();
+	#endif
 	config.read();  // Set expansion pointers from EEPROM config
-	controller.begin();  // Initialize controller bus and detect pins
+	controller.begin(I2C_Clock);  // Initialize controller bus and detect pins
+
+	#ifdef DEBUG_MEMORY
+	memoryReport();
+	#endif
 
 	DEBUG_PRINTLN("Initialization finished. Starting program...");
 }
 
 void loop() {
-	if (controller.isReady()) {
+	Frame.update();  // Read the clock once for everything in this loop
+	D_PERF(loopStart());
+	if (controller.isReady(Frame)) {
+		#ifdef CONTROLLER_MUX
+		if (controller.hasSwitched()) {
+			fx.reset();  // Don't carry over the last player's dial
+			config.select(controller.getActive());  // Main table side for this controller
+		}
+		#endif
+		#ifdef GAMEPAD
+		gamepad();
+		#else
 		djController();
-		config.check();
+		#endif
+		config.check(Frame);
 	}
-	LED.update();
+	#if defined(AIM_PREDICTION) || defined(JOY_PULSE)
+	else if (poller.newFrame() && controller.isOnline()) {
+		betweenPolls();
+	}
+	#endif
+	LED.update(Frame);
+	D_PERF(update(Frame));
+	#if defined(CONTROLLER_MUX) && defined(DEBUG_PERFORMANCE)
+	controller.report(Frame);  // Poll rate and bus time per channel
+	#endif
+	D_PROFILER(update());
+	DEBUG_UPDATE();  // Send queued debug messages
+	#ifndef DISABLE_SLEEP
+	IdleScheduler::sleep(micros());  // Idle until the next interrupt, if there's time before the next poll
+	#endif
 }
 
 void djController() {
-	// Dual turntables
-	if (dj.getNumTurntables() == 2) {
-		if (!dj.buttonMinus()) {  // Button to disable aiming (for position correction)
-			// Left is vertical, counter-clockwise is up
-			if (altTable == &dj.left) {
-				aiming(mainTable->turntable(), altTable->turntable());
-			}
-			// Right is vertical, clockwise is up
-			else {
-				aiming(mainTable->turntable(), -altTable->turntable());
-			}
-			
-		}
+	D_PROFILE(DJController);
 
-		// Movement
-		jump.press(mainTable->buttonRed());
+	HID_Report::startTransaction();  // Collect all changes from this poll into one report
 
-		// Weapons
-		fire.press(mainTable->buttonGreen() || mainTable->buttonBlue());  // Outside buttons
-		boop.press(altTable->buttonGreen() || altTable->buttonRed() || altTable->buttonBlue());
+	fx.update(Frame);  // Track the effects dial
+
+	#ifdef AIM_PREDICTION
+	aimed = false;
+	#endif
+
+	// Dual turntables
+	if (dj.getNumTurntables() == 2) {
+		#ifdef FUSED_AIM
+		FusedTurntables::update();
+		#else
+		DualTurntables::update();
+		#endif
 	}
 
 	// Single turntable (either side)
 	else if (dj.getNumTurntables() == 1) {
-		// Aiming
-		if (dj.buttonMinus()) {  // Vertical selector
-			// Left is vertical, counter-clockwise is up
-			if (dj.getTurntableConfig() == DJTurntableController::TurntableConfig::Left) { 
-				aiming(0, dj.turntable());
-			}
-			// Right is vertical, clockwise is up
-			else {
-				aiming(0, -dj.turntable());
-			}
-			
-		}
-		else {
-			aiming(dj.turntable(), 0);
-		}
-
-		// Movement
-		jump.press(dj.buttonRed());
-
-		// Weapons
-		fire.press(dj.buttonGreen());
-		boop.press(dj.buttonBlue());
+		SingleTurntable::update();
 	}
 
-	// --Base Station Abilities--
-	fx.update();
-
-	// Movement
-	joyWASD(dj.joyX(), dj.joyY());
-
-	// Weapons
-	reload.press(fx.changed(EffectThreshold) && fx.getTotal() < 0);
-
-	// Abilities
-	ultimate.press(dj.buttonEuphoria());
-	amp.press(fx.changed(EffectThreshold) && fx.getTotal() > 0);
-	crossfade.press(dj.crossfadeSlider() > 9);  // 7/8 is centered
-
-	// Fun stuff!
-	emotes.press(dj.buttonPlus());
+	BaseStation::update();
 
 	// --Cleanup--
 	if (fx.changed(EffectThreshold)) {
 		fx.reset();  // Already used abilities, reset to 0
 	}
+
+	#ifdef AIM_PREDICTION
+	if (!aimed) {
+		predictX.reset();  // Aim is off, don't keep moving between polls
+		predictY.reset();
+	}
+	#endif
+
+	HID_Report::endTransaction();  // Send the combined keyboard and mouse reports
 }
 
-void aiming(int8_t xIn, int8_t yIn) {
-	static_assert(HorizontalSens * MaxAimInput <= 127, "Your sensitivity is too high!");  // Check for signed overflow (int8_t)
-	static_assert(VerticalSens   * MaxAimInput <= 127, "Your sensitivity is too high!");
+#ifdef GAMEPAD
+void gamepad() {
+	D_PROFILE(DJController);
+	Gamepad::update();
+	HID_Gamepad::send();  // All of the controls in one report
+}
+#endif
 
-	static int8_t lastAim[2] = { 0, 0 };
-	int8_t * aim[2] = { &xIn, &yIn };  // Store in array for iterative access
+// Runs once per USB frame, for frames without a controller poll
+void betweenPolls() {
+	HID_Report::startTransaction();
 
-	// Iterate through X/Y
-	for (int i = 0; i < 2; i++) {
-		// Check if above max threshold
-		if (abs(*aim[i]) >= MaxAimInput) {
-			*aim[i] = lastAim[i];
-		}
+	#ifdef AIM_PREDICTION
+	HID_Report::mouseMove(predictX.frame(), predictY.frame());  // Fill in between polls
+	#endif
 
-		// Set 'last' value to current
-		lastAim[i] = *aim[i];
-	}
+	#ifdef JOY_PULSE
+	Movement::update();  // Keep the pulses in time
+	#endif
 
-	Mouse.move(xIn * HorizontalSens, yIn * VerticalSens);
+	HID_Report::endTransaction();
+}
+
+void aiming(int8_t xIn, int8_t yIn) {
+	// Let the poller know how close we are to the max
+	poller.reportMotion(
+		abs(xIn) >= FastPollInput || abs(yIn) >= FastPollInput,
+		abs(xIn) >= MaxAimInput || abs(yIn) >= MaxAimInput);
+
+	// Replace spurious readings
+	xIn = filterX.filter(xIn);
+	yIn = filterY.filter(yIn);
+
+	int16_t xOut = aimX.scale(xIn);
+	int16_t yOut = aimY.scale(yIn);
+
+	#ifdef AIM_PREDICTION
+	xOut = predictX.poll(xOut, poller.getElapsedFrames(), poller.getPeriod());
+	yOut = predictY.poll(yOut, poller.getElapsedFrames(), poller.getPeriod());
+	aimed = true;
+	#endif
+
+	HID_Report::mouseMove(xOut, yOut);
 
 	#ifdef DEBUG_HID
-	if (xIn != 0 || yIn != 0) {
+	if (xOut != 0 || yOut != 0) {
 		DEBUG_PRINT("Moved the mouse {");
-		DEBUG_PRINT(xIn * HorizontalSens);
+		DEBUG_PRINT(xOut);
 		DEBUG_PRINT(", ");
-		DEBUG_PRINT(yIn * VerticalSens);
+		DEBUG_PRINT(yOut);
 		DEBUG_PRINTLN("}");
 	}
 	#endif
 }
 
-void joyWASD(uint8_t x, uint8_t y) {
-	const uint8_t JoyCenter = 32;
-	const uint8_t JoyDeadzone = 6;  // +/-, centered at 32 in (0-63)
-
-	moveLeft.press(x < JoyCenter - JoyDeadzone);
-	moveRight.press(x > JoyCenter + JoyDeadzone);
-
-	moveForward.press(y > JoyCenter + JoyDeadzone);
-	moveBack.press(y < JoyCenter - JoyDeadzone);
+#ifdef DEBUG_MEMORY
+void memoryReport() {
+	MemoryReport::item("Controller", sizeof(djData) + sizeof(dj) + sizeof(controller) + sizeof(poller));
+	#ifdef CONTROLLER_MUX
+	MemoryReport::item("Mux stations", sizeof(stations) + sizeof(mux));
+	#endif
+	MemoryReport::item("Aim", sizeof(aimX) + sizeof(aimY) + sizeof(filterX) + sizeof(filterY));
+	#ifdef AIM_PREDICTION
+	MemoryReport::item("Aim prediction", sizeof(predictX) + sizeof(predictY));
+	#endif
+	MemoryReport::item("Effects", sizeof(fx));
+	MemoryReport::item("Config", sizeof(config));
+	MemoryReport::item("LED", sizeof(LED));
+	MemoryReport::item("Buttons", sizeof(fire) + sizeof(boop) + sizeof(reload) + sizeof(ultimate) + sizeof(amp) + sizeof(crossfade)
+		+ sizeof(emotes) + sizeof(moveForward) + sizeof(moveLeft) + sizeof(moveBack) + sizeof(moveRight) + sizeof(jump)
+		+ HID_Button::sharedSize());
+	MemoryReport::item("Debug log", sizeof(DebugLog));
+	#ifdef DEBUG_PERFORMANCE
+	MemoryReport::item("Performance", sizeof(Performance));
+	#endif
+	MemoryReport::remaining();
 }
+#endif
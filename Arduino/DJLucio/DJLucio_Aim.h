@@ -0,0 +1,207 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DJLucio_Aim_h
+#define DJLucio_Aim_h
+
+#include "DJLucio_Platforms.h"
+#include "DJLucio_Performance.h"
+
+// Aim values are 8.8 fixed point: 256 == 1.0
+const int16_t AimFixedOne = 256;
+
+const uint16_t AimMaxGain = 8 * AimFixedOne;  // Keeps the scaling math within 32 bits
+
+// Gain for a given turntable speed (counts per poll), in 8.8 fixed point.
+// Adds 'accel' percent for every count above the threshold.
+constexpr uint32_t accelerationGainRaw(uint8_t speed, uint8_t accel, uint8_t threshold) {
+	return speed <= threshold ? AimFixedOne : AimFixedOne + ((uint32_t)(speed - threshold) * accel * AimFixedOne) / 100;
+}
+
+constexpr uint16_t accelerationGain(uint8_t speed, uint8_t accel, uint8_t threshold) {
+	return accelerationGainRaw(speed, accel, threshold) > AimMaxGain ? AimMaxGain : accelerationGainRaw(speed, accel, threshold);
+}
+
+// AccelerationCurve: Lookup table of aim gain per turntable speed, built at compile time
+template<uint8_t Accel, uint8_t Threshold>
+class AccelerationCurve {
+public:
+	static const uint8_t Size = 32;  // Turntable reads +/- 31 at most
+	static const uint16_t MaxGain = accelerationGain(Size - 1, Accel, Threshold);  // Gain only goes up with speed
+
+	static uint16_t gain(uint8_t speed) {
+		if (speed >= Size) { speed = Size - 1; }
+		return pgm_read_word(&Table[speed]);
+	}
+
+private:
+	static const uint16_t Table[Size];
+};
+
+#define DJLUCIO_GAIN(n) accelerationGain(n, Accel, Threshold)
+
+template<uint8_t Accel, uint8_t Threshold>
+const uint16_t AccelerationCurve<Accel, Threshold>::Table[Size] PROGMEM = {
+	DJLUCIO_GAIN(0),  DJLUCIO_GAIN(1),  DJLUCIO_GAIN(2),  DJLUCIO_GAIN(3),
+	DJLUCIO_GAIN(4),  DJLUCIO_GAIN(5),  DJLUCIO_GAIN(6),  DJLUCIO_GAIN(7),
+	DJLUCIO_GAIN(8),  DJLUCIO_GAIN(9),  DJLUCIO_GAIN(10), DJLUCIO_GAIN(11),
+	DJLUCIO_GAIN(12), DJLUCIO_GAIN(13), DJLUCIO_GAIN(14), DJLUCIO_GAIN(15),
+	DJLUCIO_GAIN(16), DJLUCIO_GAIN(17), DJLUCIO_GAIN(18), DJLUCIO_GAIN(19),
+	DJLUCIO_GAIN(20), DJLUCIO_GAIN(21), DJLUCIO_GAIN(22), DJLUCIO_GAIN(23),
+	DJLUCIO_GAIN(24), DJLUCIO_GAIN(25), DJLUCIO_GAIN(26), DJLUCIO_GAIN(27),
+	DJLUCIO_GAIN(28), DJLUCIO_GAIN(29), DJLUCIO_GAIN(30), DJLUCIO_GAIN(31),
+};
+
+#undef DJLUCIO_GAIN
+
+// AimAxis: Scales turntable input to mouse counts in fixed point. The fractional
+//          part is carried over to the next poll, so slow movements aren't lost.
+//          Check the sensitivity with validSensitivity() at compile time.
+template<class Curve>
+class AimAxis {
+public:
+	AimAxis(float sensitivity) : Sensitivity(sensitivity * AimFixedOne) {}
+
+	// Whether a sensitivity fits in 8.8 fixed point, and the scaling math stays within
+	// 32 bits for any input at the curve's highest gain
+	static constexpr bool validSensitivity(float sensitivity) {
+		return sensitivity * AimFixedOne > -32768.0 && sensitivity * AimFixedOne < 32768.0 &&
+			MaxInput * Curve::MaxGain * (sensitivity < 0 ? -sensitivity : sensitivity) * AimFixedOne < 2147483648.0;
+	}
+
+	int16_t scale(int8_t input) {
+		uint16_t gain = Curve::gain(abs(input));
+		int32_t counts = ((int32_t) input * gain * Sensitivity) >> 8;  // Counts * 8.8 * 8.8, back to 8.8. See validSensitivity()
+
+		counts += residual;
+		residual = counts & (AimFixedOne - 1);  // Keep the fraction for next time
+
+		return counts >> 8;  // Whole counts only
+	}
+
+private:
+	static constexpr float MaxInput = 128.0;  // Largest input magnitude, -128 as an int8_t
+
+	const int16_t Sensitivity;  // Sensitivity multiplier, 8.8 fixed point
+	int16_t residual = 0;  // Leftover fraction of a count, 8.8 fixed point
+};
+
+// AimFilter: Rejects spurious turntable readings. Large readings are only accepted if
+//            they're close to the median of the last few samples (a real spin speeds up
+//            over a few polls, a glitch doesn't), or if the next reading agrees with them.
+class AimFilter {
+public:
+	AimFilter(int8_t maxInput, int8_t maxJump) : MaxInput(maxInput), MaxJump(maxJump) {}
+
+	int8_t filter(int8_t input) {
+		int8_t expected = median(history[0], history[1], history[2]);
+
+		if (abs(input) >= MaxInput && abs(input - expected) > MaxJump) {
+			if (!lastRejected || abs(input - rejected) > MaxJump) {
+				lastRejected = true;  // Wait for the next reading, in case it's real
+				rejected = input;
+				D_PERF(aimRejected());
+				return expected;  // Use the recent trend instead
+			}
+
+			// Two readings in a row agree, it's a real spin. Start the trend from here,
+			// so the rest of the spin isn't checked against the slower history.
+			history[0] = history[1] = history[2] = input;
+		}
+		else {
+			history[index] = input;
+			if (++index >= HistorySize) { index = 0; }
+		}
+
+		lastRejected = false;
+		return input;
+	}
+
+private:
+	static int8_t median(int8_t a, int8_t b, int8_t c) {
+		if (a > b) { int8_t t = a; a = b; b = t; }  // a <= b
+		if (b > c) { b = c; }  // b = min(b, c)
+		return a > b ? a : b;  // max(a, min(b, c))
+	}
+
+	static const uint8_t HistorySize = 3;
+
+	const int8_t MaxInput;  // Readings below this are always accepted
+	const int8_t MaxJump;  // Max distance from the median for large readings
+
+	int8_t history[HistorySize] = { 0, 0, 0 };  // Ring buffer of accepted readings
+	uint8_t index = 0;  // Next position in the ring buffer
+	boolean lastRejected = false;  // Whether the last reading was rejected
+	int8_t rejected = 0;  // Last rejected reading
+};
+
+// AimPredictor: Spreads aim motion across the USB frames between controller polls.
+//               Each frame it sends the estimated turntable velocity, and on the next
+//               poll it sends the difference between the real and the estimated motion,
+//               so the total always matches the turntable.
+class AimPredictor {
+public:
+	// Returns the motion to send for this poll
+	int16_t poll(int16_t counts, uint8_t elapsed, uint8_t period) {
+		int16_t correction = counts - emitted;  // Whatever the estimate missed
+
+		int32_t v = elapsed != 0 ? ((int32_t) counts * AimFixedOne) / elapsed : 0;
+		velocity = (v + lastVelocity) / 2;  // Average of the last two polls
+		lastVelocity = v;
+
+		framesLeft = period > 0 ? period - 1 : 0;  // Nothing for the frame with the next poll
+		emitted = 0;
+
+		return correction;
+	}
+
+	// Returns the motion to send for a frame without a poll
+	int16_t frame() {
+		if (framesLeft == 0) {
+			return 0;  // Waiting for the next poll
+		}
+		framesLeft--;
+
+		int32_t counts = fraction + velocity;
+		int16_t out = counts >> 8;  // Whole counts only
+		fraction = counts & (AimFixedOne - 1);  // Keep the fraction for next time
+
+		emitted += out;
+		return out;
+	}
+
+	// Stop the estimate, for polls that don't aim (e.g. aiming is disabled)
+	void reset() {
+		velocity = lastVelocity = 0;
+		fraction = 0;
+		emitted = 0;
+		framesLeft = 0;
+	}
+
+private:
+	int32_t velocity = 0;  // Estimated counts per frame, 8.8 fixed point
+	int32_t lastVelocity = 0;  // Counts per frame from the last poll, 8.8 fixed point
+	int16_t fraction = 0;  // Leftover fraction of a count, 8.8 fixed point
+
+	int16_t emitted = 0;  // Counts sent since the last poll
+	uint8_t framesLeft = 0;  // Frames left to fill before the next poll
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DJLucio_Capture_h
+#define DJLucio_Capture_h
+
+#ifdef DEBUG_CAPTURE
+#define D_CAPTURE(x) Capture.x
+#else
+#define D_CAPTURE(x)
+#endif
+
+#if defined(DEBUG_CAPTURE) && defined(DEBUG)
+#error DEBUG_CAPTURE sends binary data over serial and cannot be used with DEBUG
+#endif
+
+/* Capture format: one record per controller poll, each compared against the
+*  last record sent. Records are only sent while a program has the serial port
+*  open, and the stream always starts on a record boundary.
+*
+*  * Header (1 byte)
+*      bits 0-5: which of the 6 control data bytes are included, byte 0 first
+*      bit 6:    the time is 2 bytes instead of 1
+*      bit 7:    restart. The last frame is all zeroes, and records may be
+*                missing before this one (start, disconnect, or dropped data)
+*  * Time (1 or 2 bytes, little endian): milliseconds since the last record,
+*    up to 65535
+*  * Data (0 to 6 bytes): the changed control data bytes, in order
+*
+*  Records are 2 bytes while idle and 9 bytes at most. If the serial buffer
+*  doesn't have room for a record it's dropped, and the next one is a restart.
+*/
+
+// FrameCapture: Streams the raw controller data in the compact format above
+class FrameCapture {
+public:
+	static const uint8_t FrameSize = 6;  // Control data bytes
+
+	void begin() {
+		Serial.begin(115200);
+	}
+
+	void record(const uint8_t * frame, unsigned long timeNow) {
+
+		if (!Serial.dtr()) {
+			restart = true;  // Nobody listening, start over when they are
+			return;
+		}
+
+		if (restart) {
+			memset(lastFrame, 0, sizeof(lastFrame));
+		}
+
+		uint8_t buffer[1 + 2 + FrameSize];
+		uint8_t size = 1;
+		uint8_t header = restart ? Restart : 0;
+
+		unsigned long elapsed = timeNow - lastTime;
+		if (elapsed > 0xFF) {
+			if (elapsed > 0xFFFF) { elapsed = 0xFFFF; }
+			header |= LongTime;
+			buffer[size++] = elapsed & 0xFF;
+			buffer[size++] = elapsed >> 8;
+		}
+		else {
+			buffer[size++] = elapsed;
+		}
+
+		for (uint8_t i = 0; i < FrameSize; i++) {
+			if (frame[i] != lastFrame[i]) {
+				header |= (1 << i);
+				buffer[size++] = frame[i];
+			}
+		}
+		buffer[0] = header;
+
+		if (Serial.availableForWrite() < size) {
+			restart = true;  // No room, drop it rather than wait
+			return;
+		}
+
+		Serial.write(buffer, size);
+		memcpy(lastFrame, frame, sizeof(lastFrame));
+		lastTime = timeNow;
+		restart = false;
+	}
+
+	// Start over with the next record (e.g. the controller disconnected)
+	void reset() {
+		restart = true;
+	}
+
+private:
+	static const uint8_t LongTime = 1 << 6;
+	static const uint8_t Restart = 1 << 7;
+
+	uint8_t lastFrame[FrameSize];  // Control data from the last record sent
+	unsigned long lastTime = 0;  // Timestamp for the last record sent (ms)
+	boolean restart = true;  // Whether the next record is a restart
+};
+
+#ifdef DEBUG_CAPTURE
+FrameCapture Capture;
+#endif
+
+#endif
@@ -36,6 +36,176 @@
 extern DJTurntableController::TurntableExpansion * mainTable;
 extern DJTurntableController::TurntableExpansion * altTable;
 
+// ProfileStore: Saves profiles to EEPROM as a log of CRC-checked records. Each save
+//               goes to the next slot in the region, spreading wear across all of it.
+//               The newest valid record for each profile is found with one scan at boot.
+//               Templated on the storage so it can be swapped for a mock.
+template<class Profile, uint8_t NumProfiles, class Storage = EEPROMClass>
+class ProfileStore {
+public:
+	ProfileStore(Storage &s = EEPROM) : storage(s) {}
+
+	void begin() {
+		for (uint8_t i = 0; i < NumProfiles; i++) {
+			latestSlot[i] = NoSlot;
+		}
+		newestSlot = NoSlot;
+
+		for (uint8_t slot = 0; slot < NumSlots; slot++) {
+			Record record;
+			storage.get(slotAddress(slot), record);
+			if (!validRecord(record)) { continue; }
+
+			// Newest record overall, for the next write
+			if (newestSlot == NoSlot || newer(record.sequence, newestSequence)) {
+				newestSlot = slot;
+				newestSequence = record.sequence;
+			}
+
+			// Newest record for this profile
+			if (latestSlot[record.id] == NoSlot || newer(record.sequence, latestSequence[record.id])) {
+				latestSlot[record.id] = slot;
+				latestSequence[record.id] = record.sequence;
+			}
+		}
+
+		D_CFG("CFG: Scanned ");
+		D_CFG(NumSlots);
+		D_CFG(" slots, newest is ");
+		D_CFGLN(newestSlot == NoSlot ? -1 : newestSlot);
+	}
+
+	// Returns 'false' if there's no saved copy of the profile
+	boolean load(uint8_t id, Profile &out) {
+		if (id >= NumProfiles || latestSlot[id] == NoSlot) {
+			return false;
+		}
+
+		Record record;
+		storage.get(slotAddress(latestSlot[id]), record);
+		if (!validRecord(record)) {
+			return false;  // Changed since the scan?
+		}
+
+		out = record.data;
+		return true;
+	}
+
+	void save(uint8_t id, const Profile &data) {
+		if (id >= NumProfiles) {
+			return;
+		}
+
+		uint8_t slot = newestSlot == NoSlot ? 0 : (newestSlot + 1) % NumSlots;  // Next slot in the log
+
+		// If the slot has the only copy of another profile, copy that forward first.
+		// It goes to a slot without a current record, so every profile always has
+		// at least one good copy even if the power drops partway through.
+		uint8_t owner = slotOwner(slot);
+		if (owner != NoProfile && owner != id) {
+			Record moved;
+			storage.get(slotAddress(slot), moved);
+			writeRecord(freeSlotAfter(slot), owner, moved.data);
+		}
+
+		writeRecord(slot, id, data);
+
+		D_CFG("CFG: Saved profile ");
+		D_CFG(id);
+		D_CFG(" to slot ");
+		D_CFG(slot);
+		D_CFG(" (");
+		D_CFG(writes);
+		D_CFGLN(" writes since boot)");
+	}
+
+	// Region of EEPROM used for the log. Starts at 1, as address 0 is the first
+	// to be written by other programs (and the Teensy LC only has 128 bytes).
+	static const uint16_t RegionStart = 1;
+	static const uint16_t RegionSize = (E2END < 128 ? E2END : 128);
+
+private:
+	struct Record {
+		uint8_t sequence;  // Increments with every save, wraps around
+		uint8_t id;  // Profile number
+		Profile data;
+		uint8_t crc;  // CRC-8 of everything above
+	};
+
+	static const uint8_t NumSlots = RegionSize / sizeof(Record);
+	static const uint8_t NoSlot = 0xFF;
+	static const uint8_t NoProfile = 0xFF;
+	static_assert(NumSlots > NumProfiles && NumSlots < 64, "Bad EEPROM log size!");  // Each lap uses up to 2 sequence numbers per slot, needs < 128
+
+	void writeRecord(uint8_t slot, uint8_t id, const Profile &data) {
+		Record record;
+		record.sequence = newestSlot == NoSlot ? 0 : newestSequence + 1;
+		record.id = id;
+		record.data = data;
+		record.crc = crc8(&record, sizeof(Record) - 1);
+
+		storage.put(slotAddress(slot), record);  // CRC is written last, so a partial write is invalid
+
+		newestSlot = latestSlot[id] = slot;
+		newestSequence = latestSequence[id] = record.sequence;
+		writes++;
+	}
+
+	// Profile whose newest copy is in the slot, if any
+	uint8_t slotOwner(uint8_t slot) const {
+		for (uint8_t i = 0; i < NumProfiles; i++) {
+			if (latestSlot[i] == slot) { return i; }
+		}
+		return NoProfile;
+	}
+
+	// Next slot after this one without a profile's newest copy. There's always
+	// one, as there are more slots than profiles.
+	uint8_t freeSlotAfter(uint8_t slot) const {
+		for (uint8_t i = 1; i < NumSlots; i++) {
+			uint8_t next = (slot + i) % NumSlots;
+			if (slotOwner(next) == NoProfile) { return next; }
+		}
+		return slot;
+	}
+
+	static uint16_t slotAddress(uint8_t slot) {
+		return RegionStart + slot * sizeof(Record);
+	}
+
+	static boolean validRecord(const Record &record) {
+		return record.id < NumProfiles && record.crc == crc8(&record, sizeof(Record) - 1);
+	}
+
+	// Sequence numbers wrap, so 'newer' is within half the range ahead
+	static boolean newer(uint8_t a, uint8_t b) {
+		return (int8_t)(a - b) > 0;
+	}
+
+	static uint8_t crc8(const void * data, uint8_t length) {
+		const uint8_t * ptr = (const uint8_t *) data;
+		uint8_t crc = 0xFF;
+
+		while (length--) {
+			crc ^= *ptr++;
+			for (uint8_t i = 0; i < 8; i++) {
+				crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);  // CRC-8, polynomial 0x07
+			}
+		}
+		return crc;
+	}
+
+	Storage & storage;
+
+	uint8_t latestSlot[NumProfiles];  // Slot with the newest copy of each profile
+	uint8_t latestSequence[NumProfiles];
+
+	uint8_t newestSlot = NoSlot;  // Slot with the newest record of any profile
+	uint8_t newestSequence = 0;
+
+	unsigned int writes = 0;  // Number of saves since boot
+};
+
 // TurntableConfig: Handles switching between "main" and "alternate" sides of the turntable
 class TurntableConfig {
 public:
@@ -46,7 +216,9 @@ public:
 	TurntableConfig(DJTurntableController &obj, DJFunction baseFunc, ExpansionFunction exFunc, unsigned long t)
 		: Controller(obj), ConfigInput(baseFunc), SideSelectInput(exFunc), StableTime(t), limiter(t / 2) {}
 
-	void check() {
+	void check(const FrameTime &frame) {
+		D_PROFILE(Config);
+
 		if (ConfigInput == nullptr || SideSelectInput == nullptr) {
 			return;  // Bad function pointers, would otherwise throw exception
 		}
@@ -57,9 +229,9 @@ public:
 		}
 
 		// Check the held times for each control input
-		unsigned long configTime = configButton.check(configPressed);
-		unsigned long leftTime = leftExpansion.check((Controller.left.*SideSelectInput)());
-		unsigned long rightTime = rightExpansion.check((Controller.right.*SideSelectInput)());
+		unsigned long configTime = configButton.check(configPressed, frame.ms);
+		unsigned long leftTime = leftExpansion.check((Controller.left.*SideSelectInput)(), frame.ms);
+		unsigned long rightTime = rightExpansion.check((Controller.right.*SideSelectInput)(), frame.ms);
 
 		// Check if inputs have been held long enough
 		if (configTime >= StableTime) {  // Main / base input
@@ -73,17 +245,51 @@ public:
 			}
 
 			// We've made a selection! Let's save it
-			if (selection != Config::BaseOnly && limiter.ready()) {
+			if (selection != Config::BaseOnly && limiter.ready(frame.ms)) {
 				write(selection);
 			}
 		}
 	}
 
 	void read() {
-		EEPROM.get(EEPROM_Addr, currentConfig);
-		if (!validConfig(currentConfig)) {
-			D_CFGLN("CFG: EEPROM is bad! Rewriting...");
-			write(Config::Right);  // Fix dirty memory
+		store.begin();
+
+		Profile profile;
+		if (store.load(profileID, profile) && validConfig((Config) profile.side)) {
+			currentConfig = (Config) profile.side;
+		}
+		else if (profileID != 0) {
+			currentConfig = Config::Right;  // New profile, no old settings to look for
+		}
+		else {
+			D_CFGLN("CFG: No saved profile, checking the old address...");
+			EEPROM.get(Legacy_Addr, currentConfig);
+			if (!validConfig(currentConfig)) {
+				D_CFGLN("CFG: EEPROM is bad! Rewriting...");
+				currentConfig = Config::Right;
+			}
+			profile.side = (uint8_t) currentConfig;
+			store.save(profileID, profile);  // Save in the new format
+		}
+		reload();
+	}
+
+	// Switch to the profile for another controller, without rescanning the store
+	void select(uint8_t id) {
+		if (id >= NumProfiles || id == profileID) {
+			return;
+		}
+
+		profileID = id;
+		D_CFG("CFG: Using profile ");
+		D_CFGLN(id);
+
+		Profile profile;
+		if (store.load(profileID, profile) && validConfig((Config) profile.side)) {
+			currentConfig = (Config) profile.side;
+		}
+		else {
+			currentConfig = Config::Right;  // Default until one is saved
 		}
 		reload();
 	}
@@ -111,7 +317,9 @@ private:
 			return;  // Not a left/right selection, don't write to memory
 		}
 
-		EEPROM.put(EEPROM_Addr, side);  // Save in 'permanent' memory
+		Profile profile;
+		profile.side = (uint8_t) side;
+		store.save(profileID, profile);  // Save in 'permanent' memory
 		currentConfig = side;  // Save in local memory
 		reload();  // Rewrite current pointers with new selection
 
@@ -125,21 +333,31 @@ private:
 		return side == Config::Left || side == Config::Right;
 	}
 
+	// Saved settings for each profile
+	struct Profile {
+		uint8_t side;  // Main table side, as a 'Config'
+	};
+
+	static const uint8_t NumProfiles = 8;  // One per multiplexer channel
+	uint8_t profileID = 0;  // Current profile
+	ProfileStore<Profile, NumProfiles> store;
+
+	// Address used before the profile store, only read to keep old settings.
 	// Just for fun. Works out to be 540. No capital 'L' to
 	// avoid writing to the 0 address on the Teensy LC (508 % 127)
-	static const uint16_t EEPROM_Addr = ('l' + 'u' + 'c' + 'i' + 'o') % E2END;
-	static_assert(EEPROM_Addr + 1 <= E2END, "EEPROM address larger than EEPROM space!");  // Var is two bytes
+	static const uint16_t Legacy_Addr = ('l' + 'u' + 'c' + 'i' + 'o') % E2END;
+	static_assert(Legacy_Addr + 1 <= E2END, "EEPROM address larger than EEPROM space!");  // Var is two bytes
 
 	DJTurntableController & Controller;
 	const DJFunction ConfigInput;
 	const ExpansionFunction SideSelectInput;
 
 	const unsigned long StableTime;  // How long inputs must be stable for
-	RateLimiter limiter;  // Prevents spamming config writes
+	RateLimiter<> limiter;  // Prevents spamming config writes
 
-	HeldFor configButton = HeldFor(true);  // Looking for "pressed" (true) state on all 3 buttons
-	HeldFor leftExpansion = HeldFor(true);
-	HeldFor rightExpansion = HeldFor(true);
+	HeldFor<> configButton = HeldFor<>(true);  // Looking for "pressed" (true) state on all 3 buttons
+	HeldFor<> leftExpansion = HeldFor<>(true);
+	HeldFor<> rightExpansion = HeldFor<>(true);
 
 	Config currentConfig = Config::Right;  // Assume right side is 'main' if none is set
 };
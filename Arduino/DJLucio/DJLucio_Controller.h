@@ -23,6 +23,8 @@
 
 #include <NintendoExtensionCtrl.h>
 #include "DJLucio_Util.h"
+#include "DJLucio_Performance.h"
+#include "DJLucio_Capture.h"
 
 #ifdef DEBUG_CONTROLDETECT
 #define D_CD(x)   DEBUG_PRINT(x)
@@ -38,35 +40,62 @@
 #define D_COMMS(x)
 #endif
 
+#ifdef DEBUG_PERFORMANCE
+#define D_PERF_MUX(x) x
+#else
+#define D_PERF_MUX(x)
+#endif
+
 extern DJTurntableController dj;
 extern LEDHandler LED;
 
-// EffectHandler: Keeps track of changes to the turntable's "effect dial"
+// EffectHandler: Keeps track of changes to the turntable's "effect dial". A quick flick
+//                of the dial counts as changed at half the threshold, so abilities
+//                trigger before the full distance is covered.
 class EffectHandler {
 public:
-	EffectHandler(DJTurntableController &dj, unsigned long t) : fx(dj), timeout(t) {}
+	EffectHandler(DJTurntableController &dj, unsigned long t, unsigned long flickTime) : fx(dj), timeout(t), FlickTime(flickTime) {}
 
 	boolean changed(uint8_t threshold) {
-		return abs(total) >= threshold;
+		if (abs(total) >= threshold) {
+			return true;
+		}
+
+		// Flick: covered half the distance in a short time, in the same direction as the total.
+		// Needs more than one reading, so a single glitch can't trigger it.
+		return FlickTime != 0 && flickSamples >= 2 && abs(flick) >= threshold / 2 &&
+			lastMotion - flickStart <= FlickTime && sameDirection(flick, total);
 	}
 
-	void update() {
-		const uint8_t MaxChange = 5;  // Arbitrary, for spurious value check
+	void update(const FrameTime &frame) {
+		D_PROFILE(Effects);
 
 		int8_t fxChange = fx.getChange();  // Change since last update
 
 		// Check inactivity timer
 		if (fxChange != 0) {
-			timeout.reset();  // Keep alive
+			timeout.reset(frame.ms);  // Keep alive
 		}
-		else if (timeout.ready()) {
-			total = 0;
+		else if (timeout.ready(frame.ms)) {
+			reset();
 		}
 
-		if (abs(fxChange) > MaxChange) {  // Assumed spurious
-			fxChange = 0;
-		}
+		int8_t jump = 0;
+		fxChange = filter(fxChange, jump);
 		total += fxChange;
+
+		int8_t flickChange = fxChange - jump;  // A confirmed jump counts toward the total, but not a flick
+		if (flickChange != 0) {
+			unsigned long timeNow = frame.ms;
+			if (!sameDirection(flickChange, flick) || timeNow - lastMotion > FlickTime) {
+				flick = 0;  // Changed direction or paused, start a new flick
+				flickSamples = 0;
+				flickStart = timeNow;
+			}
+			flick += flickChange;
+			if (flickSamples < 255) { flickSamples++; }
+			lastMotion = timeNow;
+		}
 	}
 
 	int16_t getTotal() {
@@ -75,11 +104,54 @@ public:
 
 	void reset() {
 		total = 0;
+		flick = 0;
+		flickSamples = 0;
+		pending = 0;
 	}
 
 private:
+	// Large changes are only accepted if the dial was already turning that way, or if
+	// it keeps turning that way on the next update. A jump out of nowhere is a glitch.
+	// 'jump' is set to the part of the result that was held back from the last update.
+	int8_t filter(int8_t change, int8_t &jump) {
+		const uint8_t MaxChange = 5;  // Arbitrary, for spurious value check
+
+		int8_t accepted = 0;
+
+		if (pending != 0) {
+			if (sameDirection(pending, change)) {
+				accepted += pending;  // Confirmed, it was real
+				jump = pending;
+			}
+			pending = 0;  // Otherwise it's dropped
+		}
+
+		if (abs(change) > MaxChange && !sameDirection(change, lastChange)) {
+			pending = change;  // Wait and see
+		}
+		else {
+			accepted += change;
+		}
+
+		lastChange = accepted;
+		return accepted;
+	}
+
+	static boolean sameDirection(int16_t a, int16_t b) {
+		return (a > 0 && b > 0) || (a < 0 && b < 0);
+	}
+
 	DJTurntableController::EffectRollover fx;
-	RateLimiter timeout;  // Timeout for the fx tracker to be zero'd
+	RateLimiter<> timeout;  // Timeout for the fx tracker to be zero'd
+	const unsigned long FlickTime;  // Max time to cover half the threshold for a flick, in ms. 0 to disable.
+
+	int8_t lastChange = 0;  // Last accepted change
+	int8_t pending = 0;  // Large change waiting for the next update to confirm it
+
+	int16_t flick = 0;  // Change since the dial started turning in this direction
+	uint8_t flickSamples = 0;  // Number of readings in the flick
+	unsigned long flickStart = 0;  // Timestamp for the start of the flick (ms)
+	unsigned long lastMotion = 0;  // Timestamp for the last change (ms)
 
 	int16_t total = 0;
 };
@@ -94,19 +166,30 @@ public:
 		pinMode(Pin, INPUT);  // Requires external pull-down!
 	}
 
-	boolean isDetected() {
+	enum class State : uint8_t {
+		Absent,    // Pin is low
+		Settling,  // Pin is high, but hasn't been for long
+		Stable,    // Pin has been high for the full stable time
+	};
+
+	State getState(const FrameTime &frame) {
 		boolean currentState = digitalRead(Pin);  // Read status of CD pin
 
 		D_CD("CD pin is ");
 		D_CD(currentState ? "HIGH " : "LOW ");
 
+		if (currentState == HIGH && lastState == LOW) {
+			D_PERF(controllerPlugged());  // Start the hotplug timer
+		}
+		lastState = currentState;
+
 		if (currentState == HIGH && detected == true) {
 			D_CDLN("Controller connected!");
-			return true;  // We're still good!
+			return State::Stable;  // We're still good!
 		}
 
 		// Check how long the pin has been high. 0 if it's low.
-		unsigned long currentTime = stateDuration.check(currentState);
+		unsigned long currentTime = stateDuration.check(currentState, frame.ms);
 
 		D_CD("Stable for: ");
 		D_CD(currentTime);
@@ -114,105 +197,802 @@ public:
 		D_CD(StableTime);
 		D_CDLN();
 
-		return detected = currentTime >= StableTime;  // Set flag and return to user.
+		detected = currentTime >= StableTime;  // Set flag and return to user.
+
+		if (detected) { return State::Stable; }
+		return currentState == HIGH ? State::Settling : State::Absent;
 	}
 
 private:
 	const uint8_t Pin;  // Connected pin to read from. High == connected, Low == disconnected (needs pull-down)
 	unsigned long StableTime;  // Time before the connection is considered "stable", in milliseconds
 
-	HeldFor stateDuration = HeldFor(HIGH, HIGH);  // Looking for a high connection, assume first read was high
+	HeldFor<> stateDuration = HeldFor<>(HIGH, HIGH);  // Looking for a high connection, assume first read was high
 	boolean detected = true;  // Assume controller is detected for first call
+	boolean lastState = HIGH;  // Last pin state, for catching a new connection
+};
+
+// IdleScheduler: Puts the CPU to sleep at the end of the loop if nothing needs to
+//                run for a while. Anything waiting on a sub-millisecond deadline
+//                reports how long it can wait, and the CPU only sleeps if the
+//                earliest deadline is far enough away that the next interrupt
+//                (millis() tick or USB frame) will wake it in time. Timers that
+//                count in milliseconds don't need to report, the loop still runs
+//                after every interrupt.
+class IdleScheduler {
+public:
+	// Something needs to run again in 'wait' microseconds from 'timeNow' (micros())
+	static void due(unsigned long wait, unsigned long timeNow) {
+		unsigned long deadline = timeNow + wait;
+		if (!scheduled || (long) (deadline - nextDeadline) < 0) {
+			nextDeadline = deadline;
+			scheduled = true;
+		}
+	}
+
+	// Nothing needs to run before the next interrupt, only timers that count in
+	// milliseconds are waiting
+	static void idle(unsigned long timeNow) {
+		due(Forever, timeNow);
+	}
+
+	// Something needs to run again right away
+	static void busy() {
+		awake = true;
+	}
+
+	// Sleep until the next interrupt, if there's time. Call once at the end of the loop,
+	// with the current time (micros()).
+	static void sleep(unsigned long timeNow) {
+		if (!awake && scheduled && (long) (nextDeadline - timeNow) > (long) WakeTime) {
+			sleepCPU();
+		}
+		scheduled = false;  // Deadlines are reported again each loop
+		awake = false;
+	}
+
+	static const unsigned long WakeTime = 1500;  // Longest time between interrupts, plus margin (us)
+	static const unsigned long Forever = 0x7FFFFFFF;  // Wait for a deadline that isn't coming (us)
+
+private:
+	static boolean scheduled;  // Whether there's a deadline this loop. If not, don't sleep.
+	static boolean awake;  // Whether something needs to run right away
+	static unsigned long nextDeadline;  // Timestamp for the earliest deadline (us)
+};
+
+boolean IdleScheduler::scheduled = false;
+boolean IdleScheduler::awake = false;
+unsigned long IdleScheduler::nextDeadline = 0;
+
+// PollScheduler: Decides when to poll the controller. Polls are timed to finish just
+//                before the next USB frame, so new data reaches the host in the next
+//                report. Polls faster while the turntable is near its maximum reading
+//                and slower once the controller has been idle for a while.
+class PollScheduler {
+public:
+	PollScheduler(unsigned long pollTime, unsigned long fastTime, unsigned long idleTime, unsigned long idleTimeout) :
+		PollFrames(pollTime), FastFrames(fastTime), IdleFrames(idleTime), IdleTimeout(idleTimeout) {}
+
+	// Returns 'true' if it's time to start a new controller read
+	boolean ready() {
+		unsigned long timeNow = micros();
+
+		#ifdef USB_FRAME_COUNTER
+		uint16_t frame = getUSBFrame();
+		if (frame != lastFrame) {  // New USB frame
+			lastFrame = frame;
+			frameStart = timeNow;
+			countFrame();
+		}
+		else if (timeNow - frameStart >= FrameTimeout) {  // No frames (USB suspended?), run free
+			frameStart += FrameLength;
+			countFrame();
+		}
+		#else
+		if (timeNow - frameStart >= FrameLength) {
+			frameStart += FrameLength;
+			countFrame();
+		}
+		#endif
+
+		unsigned long framePosition = timeNow - frameStart;
+
+		if (framesSincePoll < period) {
+			unsigned long framesLeft = period - framesSincePoll;
+			IdleScheduler::due(framesLeft * FrameLength + (FrameLength - LeadTime) - framePosition, timeNow);
+			return false;  // Not time to poll yet
+		}
+
+		if (framePosition < FrameLength - LeadTime) {
+			IdleScheduler::due((FrameLength - LeadTime) - framePosition, timeNow);
+			return false;  // Wait until just before the frame boundary
+		}
+
+		elapsedFrames = framesSincePoll;
+		framesSincePoll = 0;
+		frameStarted = false;  // Poll takes the place of this frame
+		return true;
+	}
+
+	// Returns 'true' once per USB frame, for frames without a poll
+	boolean newFrame() {
+		boolean started = frameStarted;
+		frameStarted = false;
+		return started;
+	}
+
+	// Number of frames between the last two polls
+	uint8_t getElapsedFrames() const {
+		return elapsedFrames;
+	}
+
+	// Number of frames until the next poll
+	uint8_t getPeriod() const {
+		return period;
+	}
+
+	// Adjust the polling rate based on the latest data
+	void polled(boolean changed, const FrameTime &frame) {
+		if (changed) {
+			lastActive = frame.ms;
+		}
+		idle = frame.ms - lastActive >= IdleTimeout;
+		setPeriod();
+	}
+
+	// Report the aim input from the latest data, to check for saturation.
+	// Called after polled(), so the new rate applies from the next poll.
+	void reportMotion(boolean approaching, boolean saturated) {
+		nearSaturation = approaching || saturated;
+		setPeriod();
+		if (saturated) {
+			D_PERF(pollSaturated());
+		}
+	}
+
+	static const unsigned long FrameLength = 1000;  // Length of a full speed USB frame, in microseconds (us)
+	static const unsigned long FrameTimeout = FrameLength + FrameLength / 2;  // Time without a frame before running free (us)
+	static const unsigned long LeadTime = 700;  // Time before the frame boundary to start the read (us)
+
+private:
+	void countFrame() {
+		if (framesSincePoll != 255) { framesSincePoll++; }  // Don't overflow
+		frameStarted = true;
+	}
+
+	void setPeriod() {
+		if (nearSaturation) {
+			period = FastFrames;  // Spinning fast, poll faster to avoid clipping
+		}
+		else if (idle) {
+			period = IdleFrames;  // Nothing's happening, back off
+		}
+		else {
+			period = PollFrames;
+		}
+	}
+
+	const uint8_t PollFrames;  // Standard polling rate, in frames (ms)
+	const uint8_t FastFrames;  // Polling rate near saturation (ms)
+	const uint8_t IdleFrames;  // Polling rate while idle (ms)
+	const unsigned long IdleTimeout;  // Time without changes before the controller is considered idle (ms)
+
+	uint8_t period = PollFrames;  // Current polling rate, in frames
+	uint8_t framesSincePoll = 255;  // Guarantee 'ready' on first frame
+	uint8_t elapsedFrames = 0;  // Frames between the last two polls
+	boolean frameStarted = false;  // Flag for a new frame
+
+	uint16_t lastFrame = 0;  // Last seen USB frame number
+	unsigned long frameStart = 0;  // Timestamp for the start of the current frame (us)
+
+	unsigned long lastActive = 0;  // Timestamp for the last data change (ms)
+	boolean nearSaturation = false;  // Whether the last aim input was close to the max
+	boolean idle = false;  // Whether the controller has gone without changes for the idle timeout
+};
+
+// AsyncReader: Reads the controller's data in stages, so the loop can keep running
+//              while the controller prepares its data and the bus transfers it.
+//              Templated on the bus type so it can be swapped for a mock.
+template<class Bus = NXC_I2C_TYPE>
+class AsyncReader {
+public:
+	enum class Status : uint8_t {
+		Idle,     // Nothing to do
+		Busy,     // Read in progress
+		Done,     // New data is ready
+		Failed,   // Bus error or bad data
+	};
+
+	AsyncReader(Bus &b, ExtensionData &d) : bus(b), data(d) {}
+
+	// Ask the controller to prepare new data
+	boolean start() {
+		if (state != State::Idle) {
+			return false;  // Already reading
+		}
+
+		D_PERF(busStart());
+		bus.beginTransmission(I2C_Addr);
+		bus.write(0x00);  // Control data starts at address 0
+		boolean success = bus.endTransmission() == 0;
+		D_PERF(busEnd());
+
+		if (!success) {
+			return false;
+		}
+
+		requestTime = micros();
+		state = State::Converting;
+		return true;
+	}
+
+	// Move the read forward, if it's ready for the next stage
+	Status update() {
+		switch (state) {
+			case(State::Idle):
+				return Status::Idle;
+
+			case(State::Converting):
+				if (micros() - requestTime < ConversionTime) {
+					return Status::Busy;  // Controller isn't ready yet
+				}
+				return request();
+
+			case(State::Reading):
+				return collect();
+		}
+		return Status::Idle;
+	}
+
+	void reset() {
+		state = State::Idle;
+	}
+
+	boolean isBusy() const {
+		return state != State::Idle;
+	}
+
+	static const uint8_t I2C_Addr = 0x52;  // Address for all extension controllers
+	static const uint8_t RequestSize = 6;  // Number of control data bytes
+	static const unsigned long ConversionTime = 175;  // Time for the controller to prepare its data (us)
+
+private:
+	enum class State : uint8_t {
+		Idle,
+		Converting,  // Waiting for the controller
+		Reading,     // Waiting for the bus
+	};
+
+	Status request() {
+		D_PERF(busStart());
+
+		#ifdef I2C_T3_H
+		bus.sendRequest(I2C_Addr, RequestSize, I2C_STOP);  // Non-blocking, runs on interrupts
+		D_PERF(busEnd());
+		state = State::Reading;
+		return Status::Busy;
+		#else
+		uint8_t received = bus.requestFrom(I2C_Addr, RequestSize);  // Blocking
+		D_PERF(busEnd());
+		if (received != RequestSize) {
+			state = State::Idle;
+			return Status::Failed;
+		}
+		return collect();
+		#endif
+	}
+
+	Status collect() {
+		#ifdef I2C_T3_H
+		if (!bus.done()) {
+			return Status::Busy;  // Still transferring
+		}
+		#endif
+		state = State::Idle;
+
+		if (bus.available() < RequestSize) {
+			return Status::Failed;
+		}
+
+		boolean allHigh = true;
+		for (uint8_t i = 0; i < RequestSize; i++) {
+			data.controlData[i] = bus.read();
+			if (data.controlData[i] != 0xFF) { allHigh = false; }
+		}
+
+		return allHigh ? Status::Failed : Status::Done;  // All 0xFF is a missing controller
+	}
+
+	Bus & bus;
+	ExtensionData & data;
+
+	State state = State::Idle;
+	unsigned long requestTime = 0;  // Timestamp for the start of the read (us)
 };
 
 // ConnectionHelper: Keeps track of the controller's 'connected' state, and auto-updates control data
 class ConnectionHelper {
 public:
-	ConnectionHelper(ExtensionController &con, uint8_t cdPin, unsigned long pollTime, unsigned long cdWaitTime, unsigned long reconnectTime) :
-		controller(con), detect(cdPin, cdWaitTime), pollRate(pollTime), reconnectRate(reconnectTime) {}
+	ConnectionHelper(ExtensionController &con, ExtensionData &data, uint8_t cdPin, PollScheduler &poll, unsigned long cdWaitTime, unsigned long reconnectMin, unsigned long reconnectMax) :
+		controller(con), bus(data.i2c), reader(data.i2c, data), detect(cdPin, cdWaitTime), pollRate(poll), reconnectRate(reconnectMin, reconnectMax) {}
 
-	void begin() {
+	void begin(uint32_t clockSpeed) {
 		detect.begin();  // Initialize CD pin as input
 		controller.begin();  // Start I2C bus
-		LED.blink(LED_BlinkSpeed);  // Start the LED blinking (disconnected)
+		clock = clockSpeed;
+		bus.setClock(clock);
+		if (outputs) {
+			LED.blink(LED_BlinkSpeed);  // Start the LED blinking (disconnected)
+		}
 	}
 
 	// Automatically connects the controller, checks if it's ready for a new update, and 
-	// returns 'true' if there is new data to process.
-	boolean isReady() {
-		if (pollRate.ready() && isConnected()) {
-			if (!controller.update()) {  // Fetch new data
-				disconnect();
-				D_COMMS("Controller update failed :(");
-			}
-			else {
+	// returns 'true' if there is new data to process. Reads happen in the background
+	// over several calls, so this should be called as often as possible.
+	boolean isReady(const FrameTime &frame) {
+		D_PROFILE(Poll);
+
+		switch (reader.update()) {
+			case(Reader::Status::Busy):
+				IdleScheduler::busy();
+				return false;  // Still reading, check back later
+			case(Reader::Status::Done):
 				D_COMMS("Successul update!");
+				failures = 0;
+				D_PERF(pollCompleted());
+				D_PERF(inputReceived());
+				changed = dataChanged();
+				pollRate.polled(changed, frame);
+				D_CAPTURE(record(lastData, frame.ms));
 				#ifdef DEBUG_RAW
-				dj.printDebug();
+				printRaw();
 				#endif
+				return connected;
+			case(Reader::Status::Failed):
+				D_COMMS("Controller update failed :(");
+				retry();
+				return false;
+			case(Reader::Status::Idle):
+				break;
+		}
+
+		if (pollRate.ready() && isConnected(frame)) {
+			if (!reader.start()) {  // Start fetching new data
+				D_COMMS("Controller update request failed :(");
+				retry();
 			}
-			return connected;
 		}
 
 		return false;
 	}
 
-	boolean isConnected() {
+	// Whether the controller is connected, without checking again
+	boolean isOnline() const {
+		return connected;
+	}
+
+	// Whether a read is in progress
+	boolean isReading() const {
+		return reader.isBusy();
+	}
+
+	// Whether the latest data is different from the data before it
+	boolean hasChanged() const {
+		return changed;
+	}
+
+	// Whether this connection drives the HID outputs and the LED. With several
+	// controllers only the active one does, the others leave them alone.
+	void setOutputs(boolean state) {
+		outputs = state;
+		if (outputs) {
+			showStatus();
+		}
+	}
+
+	// A read couldn't happen for a reason outside this connection (e.g. the
+	// multiplexer didn't switch to it). Counts as a failed read.
+	void missedRead() {
+		if (connected && ++failures > MaxRetries) {
+			disconnect();
+		}
+	}
+
+	boolean isConnected(const FrameTime &frame) {
+		if (connectDue(frame)) {
+			connect();
+		}
+		return connected;
+	}
+
+	// Checks the detect pin and drops the connection if the controller is gone. Returns
+	// 'true' if it's time to try connecting. Doesn't touch the bus.
+	boolean connectDue(const FrameTime &frame) {
+		ControllerDetect::State detected = controllerDetected(frame);
+
 		// Check if the controller detect pin is inactive.
 		// If so, invalidate any present connection
-		if (!controllerDetected()) {
+		if (detected == ControllerDetect::State::Absent) {
 			D_COMMS("Controller not detected (check your connections)");
 			if (connected) { disconnect(); }  // Disconnect if connected
 			return false;  // No controller detected? Nothing else to do here
 		}
 
 		// Controller detect pin is high! So let's check our initialization.
-		// If not connected, attempt connection at regular interval
-		if (!connected && reconnectRate.ready()) {
-			D_COMMS("Connecting to controller...");
-			if (controller.connect()) {
-				onConnect();  // Successsful connection!
-			}
+		// Don't wait for the pin to settle, if the pin drops while settling
+		// the connection is dropped above. If not connected, attempt
+		// connection with an increasing delay between attempts.
+		if (!connected && reconnectRate.ready(frame.ms)) {
+			D_COMMS(detected == ControllerDetect::State::Stable ? "Connecting to controller..." : "Connecting to controller (early)...");
+			return true;
 		}
+		return false;
+	}
 
+	// Initialize the controller. Call when connectDue() says it's time.
+	boolean connect() {
+		if (controller.connect()) {
+			onConnect();  // Successsful connection!
+		}
+		else {
+			reconnectRate.failed();  // Wait longer next time
+		}
 		return connected;
 	}
 
 private:
 	void onConnect() {
-		LED.write(HIGH);  // LED high = connected
-		LED.stopBlinking();
 		connected = true;
+		if (outputs) { showStatus(); }
+		reconnectRate.reset();  // Quick retry if it disconnects
 		D_COMMS("Controller successfully connected!");	
 	}
 
+	// Try the read again, after resetting the bus if it's failed before. A request
+	// that fails here counts as another failure, so a stuck bus is reset too.
+	// Buttons stay pressed until the retries are used up.
+	void retry() {
+		while (++failures <= MaxRetries) {
+			D_PERF(busRetry());
+
+			if (failures > 1) {
+				D_COMMS("Resetting the bus...");
+				D_PERF(busRecovery());
+				recoverBus();
+				if (!controller.connect()) {  // Re-initialize the extension
+					continue;
+				}
+			}
+
+			if (reader.start()) {
+				return;  // Reading again
+			}
+			D_COMMS("Controller update request failed :(");
+		}
+
+		disconnect();  // Out of chances
+	}
+
+	// Clock out a slave that's holding the data line, then restart the bus
+	void recoverBus() {
+		#ifdef I2C_T3_H
+		bus.resetBus();
+		#else
+		bus.end();
+
+		// Open drain: 'high' is released (pull-up), 'low' is driven
+		pinMode(SDA_Pin, INPUT_PULLUP);
+		pinMode(SCL_Pin, INPUT_PULLUP);
+
+		for (uint8_t i = 0; i < 9 && digitalRead(SDA_Pin) == LOW; i++) {
+			pinMode(SCL_Pin, OUTPUT);
+			digitalWrite(SCL_Pin, LOW);
+			delayMicroseconds(5);
+			pinMode(SCL_Pin, INPUT_PULLUP);
+			delayMicroseconds(5);
+		}
+
+		// Send a stop condition (SDA rising while SCL is high)
+		pinMode(SDA_Pin, OUTPUT);
+		digitalWrite(SDA_Pin, LOW);
+		delayMicroseconds(5);
+		pinMode(SDA_Pin, INPUT_PULLUP);
+		delayMicroseconds(5);
+		#endif
+
+		controller.begin();  // Restart the bus
+		bus.setClock(clock);
+	}
+
 	void disconnect() {
-		HID_Button::releaseAll();  // Something went wrong, clear current pressed buttons
-		LED.write(LOW);  // LED low = disconnected
-		LED.blink(LED_BlinkSpeed);  // ... also blinking
+		failures = 0;
+		reader.reset();  // Drop any read in progress
+		D_CAPTURE(reset());
 		connected = false;
+		if (outputs) {
+			HID_Button::releaseAll();  // Something went wrong, clear current pressed buttons
+			#ifdef GAMEPAD
+			HID_Gamepad::releaseAll();
+			#endif
+			showStatus();
+		}
 		D_COMMS("Uh oh! Controller disconnected");
 	}
 
-	boolean controllerDetected() {
+	// Show the connection state on the LED
+	void showStatus() {
+		if (connected) {
+			LED.write(HIGH);  // LED high = connected
+			LED.stopBlinking();
+		}
+		else {
+			LED.write(LOW);  // LED low = disconnected
+			LED.blink(LED_BlinkSpeed);  // ... also blinking
+		}
+	}
+
+	#ifdef DEBUG_RAW
+	// Queue the control data as hex, in order with the other debug output
+	void printRaw() {
+		DEBUG_PRINT("RAW:");
+		for (uint8_t i = 0; i < sizeof(lastData); i++) {
+			DEBUG_PRINT(' ');
+			DEBUG_PRINTHEX(lastData[i]);
+		}
+		DEBUG_PRINTLN();
+	}
+	#endif
+
+	// Check if the control data is different from the last update
+	boolean dataChanged() {
+		boolean changed = false;
+
+		for (uint8_t i = 0; i < sizeof(lastData); i++) {
+			uint8_t data = controller.getControlData(i);
+			if (data != lastData[i]) {
+				lastData[i] = data;
+				changed = true;
+			}
+		}
+
+		return changed;
+	}
+
+	ControllerDetect::State controllerDetected(const FrameTime &frame) {
 		#ifdef IGNORE_DETECT_PIN 
-			return true;  // No detect pin, just assume the controller is there
+			(void) frame;
+			return ControllerDetect::State::Stable;  // No detect pin, just assume the controller is there
 		#else
-			return detect.isDetected();
+			return detect.getState(frame);
 		#endif
 	}
 
 	static const float LED_BlinkSpeed;
 
+	typedef AsyncReader<> Reader;
+
+	static const uint8_t MaxRetries = 2;  // Reads to retry before disconnecting. Retries after the first reset the bus
+
 	ExtensionController & controller;
+	NXC_I2C_TYPE & bus;
+	Reader reader;
 	ControllerDetect detect;
 
-	RateLimiter pollRate;
-	RateLimiter reconnectRate;
+	PollScheduler & pollRate;
+	Backoff<> reconnectRate;
+
+	uint8_t lastData[6];  // Control data from the last update, for checking activity
 
 	boolean connected = false;
+	boolean outputs = true;  // Whether this connection drives the HID outputs and the LED
+	boolean changed = false;  // Whether the last read had new data
+	uint8_t failures = 0;  // Number of failed reads in a row
+	uint32_t clock = 100000;  // I2C clock speed, in Hz
 };
 
 const float ConnectionHelper::LED_BlinkSpeed = 0.5;  // Hertz
 
+// I2CMux: TCA9548A style I2C multiplexer. Each bit of its control register
+//         connects one channel to the bus.
+template<class Bus = NXC_I2C_TYPE>
+class I2CMux {
+public:
+	I2CMux(Bus &b, uint8_t addr = 0x70) : bus(b), Address(addr) {}
+
+	boolean select(uint8_t channel) {
+		if (channel == current) {
+			return true;  // Already there
+		}
+
+		bus.beginTransmission(Address);
+		bus.write(1 << channel);
+		if (bus.endTransmission() != 0) {
+			current = NoChannel;  // Unknown, set it again next time
+			return false;
+		}
+
+		current = channel;
+		return true;
+	}
+
+	static const uint8_t MaxChannels = 8;
+
+private:
+	static const uint8_t NoChannel = 0xFF;
+
+	Bus & bus;
+	const uint8_t Address;
+	uint8_t current = NoChannel;
+};
+
+// ControllerStation: Data and connection for one controller behind the multiplexer
+struct ControllerStation {
+	ControllerStation(uint8_t cdPin, PollScheduler &poll, unsigned long cdWaitTime, unsigned long reconnectMin, unsigned long reconnectMax) :
+		controller(data), connection(controller, data, cdPin, poll, cdWaitTime, reconnectMin, reconnectMax) {}
+
+	ExtensionData data;
+	DJTurntableController controller;
+	ConnectionHelper connection;
+};
+
+// ControllerGroup: Several controllers behind an I2C multiplexer, sharing the bus and
+//                  the poll schedule. Each poll goes to the next connected controller
+//                  in turn, and each has its own detect pin and connection state.
+//                  One controller at a time drives the outputs, and its data is
+//                  copied to the main controller object. Another controller takes
+//                  over when it's used while the active one is idle or disconnected.
+template<uint8_t N, class Bus = NXC_I2C_TYPE>
+class ControllerGroup {
+public:
+	static_assert(N > 0 && N <= I2CMux<Bus>::MaxChannels, "Bad number of multiplexer channels!");
+
+	ControllerGroup(I2CMux<Bus> &m, ControllerStation (&s)[N], ExtensionData &out, unsigned long idleTime) :
+		mux(m), stations(s), output(out), IdleTime(idleTime) {}
+
+	void begin(uint32_t clockSpeed) {
+		for (uint8_t i = 0; i < N; i++) {
+			stations[i].connection.setOutputs(i == active);  // Only the active controller drives the HID outputs and LED
+			stations[i].connection.begin(clockSpeed);
+		}
+	}
+
+	// Returns 'true' if the active controller has new data
+	boolean isReady(const FrameTime &frame) {
+		// Skip past the offline channels. The multiplexer only switches to one to
+		// connect, once its controller is detected and the reconnect wait is up.
+		for (uint8_t i = 0; i < N && !stations[turn].connection.isOnline(); i++) {
+			ConnectionHelper & connection = stations[turn].connection;
+			if (connection.connectDue(frame) && mux.select(turn) && connection.connect()) {
+				break;  // Poll it on its turn
+			}
+			nextTurn();
+		}
+
+		const uint8_t channel = turn;
+		ConnectionHelper & connection = stations[channel].connection;
+
+		if (!connection.isOnline()) {
+			IdleScheduler::idle(micros());  // Nothing to poll, wait on the detect pins and reconnect timers
+			return false;
+		}
+
+		if (!mux.select(channel)) {
+			connection.missedRead();  // Don't read whichever controller is still selected
+			nextTurn();
+			return false;
+		}
+
+		boolean ready = connection.isReady(frame);
+
+		// Next channel once this one's read is done, or right away if it's disconnected
+		if (connection.isReading()) {
+			if (!turnReading) {
+				turnReading = true;
+				D_PERF_MUX(readStart = micros());
+			}
+		}
+		else if (turnReading || !connection.isOnline()) {
+			D_PERF_MUX(if (turnReading) { busTime[channel] += micros() - readStart; });
+			turnReading = false;
+			nextTurn();
+		}
+
+		if (!ready) {
+			return false;
+		}
+		D_PERF_MUX(polls[channel]++);
+
+		if (channel != active) {
+			boolean activeIdle = frame.ms - lastActive >= IdleTime || !stations[active].connection.isOnline();
+			if (!connection.hasChanged() || !activeIdle) {
+				return false;  // Someone else is playing
+			}
+			HID_Button::releaseAll();  // Clear the old controller's inputs
+			#ifdef GAMEPAD
+			HID_Gamepad::releaseAll();
+			#endif
+			stations[active].connection.setOutputs(false);
+			connection.setOutputs(true);
+			active = channel;
+			switched = true;
+			D_COMMS("Switched to a new controller");
+		}
+
+		if (connection.hasChanged()) {
+			lastActive = frame.ms;
+		}
+
+		memcpy(output.controlData, stations[channel].data.controlData, AsyncReader<Bus>::RequestSize);
+		return true;
+	}
+
+	// Whether the active controller is connected
+	boolean isOnline() const {
+		return stations[active].connection.isOnline();
+	}
+
+	// Channel number of the controller driving the outputs
+	uint8_t getActive() const {
+		return active;
+	}
+
+	// Returns 'true' once after a different controller takes over
+	boolean hasSwitched() {
+		boolean s = switched;
+		switched = false;
+		return s;
+	}
+
+	#ifdef DEBUG_PERFORMANCE
+	// Prints the poll rate and bus use for each channel, once per second
+	void report(const FrameTime &frame) {
+		unsigned long timeNow = frame.ms;
+		if (!reportRate.ready(timeNow)) {
+			return;
+		}
+
+		unsigned long elapsed = timeNow - periodStart;
+		if (elapsed == 0) { elapsed = 1; }
+
+		for (uint8_t i = 0; i < N; i++) {
+			DEBUG_PRINT("MUX: Channel ");
+			DEBUG_PRINT(i);
+			DEBUG_PRINT(i == active ? " (active)" : "");
+			DEBUG_PRINT(" | Polls/s ");
+			DEBUG_PRINT((polls[i] * 1000UL) / elapsed);
+			DEBUG_PRINT(" | Bus (us/s) ");
+			DEBUG_PRINTLN((busTime[i] * 1000UL) / elapsed);
+			polls[i] = 0;
+			busTime[i] = 0;
+		}
+		periodStart = timeNow;
+	}
+	#endif
+
+private:
+	// Moves on to the next channel. The multiplexer switches when it's used.
+	void nextTurn() {
+		if (++turn >= N) { turn = 0; }
+	}
+
+	I2CMux<Bus> & mux;
+	ControllerStation (&stations)[N];
+	ExtensionData & output;  // Data for the main controller object
+	const unsigned long IdleTime;  // Time without changes before another controller can take over (ms)
+
+	uint8_t turn = 0;  // Channel being polled
+	boolean turnReading = false;  // Whether the current channel has started a read
+	uint8_t active = 0;  // Channel driving the outputs
+	boolean switched = false;  // Flag for a new active channel
+	unsigned long lastActive = 0;  // Timestamp for the last change on the active channel (ms)
+
+	#ifdef DEBUG_PERFORMANCE
+	RateLimiter<> reportRate = RateLimiter<>(1000);
+	unsigned long periodStart = 0;
+	unsigned long readStart = 0;  // Timestamp for the start of the current read (us)
+	unsigned long polls[N] = {};  // Reads per channel this period
+	unsigned long busTime[N] = {};  // Time spent reading per channel this period (us)
+	#endif
+};
+
 #endif
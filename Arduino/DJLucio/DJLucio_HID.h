@@ -21,9 +21,29 @@
 #ifndef DJLucio_HID_h
 #define DJLucio_HID_h
 
+// The 32U4 boards use a custom descriptor, with 16-bit mouse motion and n-key rollover.
+// Teensy boards can only use the descriptors built into the core.
+#if defined(__AVR_ATmega32U4__) && !defined(TEENSYDUINO) && !defined(STOCK_HID)
+#define CUSTOM_HID
+#endif
+
+#if defined(GAMEPAD) && defined(TEENSYDUINO) && !defined(JOYSTICK_INTERFACE)
+#error No joystick! Did you select a USB type with Joystick?
+#elif defined(GAMEPAD) && !defined(TEENSYDUINO) && !defined(CUSTOM_HID)
+#error The gamepad needs the custom HID descriptor, remove STOCK_HID
+#endif
+
+#ifdef CUSTOM_HID
+#include <HID.h>
+#else
 #include <Mouse.h>
 #include <Keyboard.h>
+#ifndef TEENSYDUINO
+#include <HID.h>
+#endif
+#endif
 #include "DJLucio_Util.h"
+#include "DJLucio_Performance.h"
 
 #ifdef DEBUG_HID
 #define D_HID(x)   DEBUG_PRINT(x)
@@ -33,147 +53,618 @@
 #define D_HIDLN(x)
 #endif
 
-// HID_Button: Handles HID button state to prevent input spam
-class HID_Button {
+// HID_Report: Keeps the keyboard and mouse report state, and sends them to the host.
+//             Inside a transaction all changes are held and sent together at the
+//             end as (at most) one keyboard report and one mouse report.
+//             Button changes are only sent by HID_Button (see below).
+class HID_Report {
 public:
-	HID_Button(uint16_t k) : key(k) {
-		// If linked list is empty, set both head and tail
-		if (head == nullptr) {
-			head = this;
-			tail = this;
-		}
-		// If linked list is *not* empty, set the 'next' ptr of the tail
-		// and update the tail
-		else {
-			tail->next = this;
-			tail = this;
-		}
+	static void begin() {
+		#ifndef CUSTOM_HID
+		Keyboard.begin();
+		Mouse.begin();
+		#endif
 	}
 
-	~HID_Button() {
-		// If we're at the start of the list...
-		if (this == head) {
-			// Option #1: Only element in the list
-			if (this == tail) {
-				head = nullptr;
-				tail = nullptr;  // List is now empty
+	static void startTransaction() {
+		inTransaction = true;
+	}
+
+	static void endTransaction();  // Defined after HID_Button, which it flushes
+
+	static boolean isInTransaction() {
+		return inTransaction;
+	}
+
+	static void keyboardPress(uint16_t key, boolean state) {
+		uint8_t modifier = getModifier(key);
+
+		if (modifier != 0) {
+			if (state) { keyReport.modifiers |= modifier; }
+			else { keyReport.modifiers &= ~modifier; }
+		}
+		else {
+			uint8_t usage = getUsage(key);
+			if (usage == 0) { return; }  // Unsupported key, nothing to send
+
+			if (isShifted(key)) {  // Held with shift, counted so it's released with the last one
+				if (state) { shiftedKeys++; }
+				else if (shiftedKeys > 0) { shiftedKeys--; }
 			}
-			// Option #2: First element in the list,
-			// but not *only* element
-			else {
-				head = next;  // Set head to next, and we're done
+
+			#ifdef CUSTOM_HID
+			if (usage >= sizeof(keyReport.keys) * 8) { return; }  // Outside the bitmap
+			uint8_t bit = 1 << (usage % 8);
+			if (state) { keyReport.keys[usage / 8] |= bit; }
+			else { keyReport.keys[usage / 8] &= ~bit; }
+			#else
+			for (uint8_t i = 0; i < sizeof(keyReport.keys); i++) {
+				if (state && keyReport.keys[i] == 0) {
+					keyReport.keys[i] = usage;  // Found an empty slot
+					break;
+				}
+				else if (!state && keyReport.keys[i] == usage) {
+					keyReport.keys[i] = 0;  // Clear the slot
+					break;
+				}
 			}
-			return;
+			#endif
 		}
 
-		// Option #3: Somewhere else in the list.
-		// Iterate through to find it
-		HID_Button * ptr = head;
+		keyboardChanged = true;
+	}
 
-		while (ptr != nullptr) {
-			if (ptr->next == this) {  // FOUND!
-				ptr->next = next;  // Set the previous "next" as this entry's "next" (skip this object)
-				break;  // Stop searching
-			}
-			ptr = ptr->next;  // Not found. Next entry...
+	static void mousePress(uint8_t button, boolean state) {
+		if (state) { mouseButtons |= button; }
+		else { mouseButtons &= ~button; }
+
+		mouseChanged = true;
+	}
+
+	static void mouseMove(int16_t x, int16_t y) {
+		if (x == 0 && y == 0) { return; }  // No motion, no report
+
+		mouseX += x;  // Accumulate until the report is sent
+		mouseY += y;
+
+		mouseChanged = true;
+		if (!inTransaction) { send(); }
+	}
+
+	static void send() {
+		if (keyboardChanged) {
+			D_PROFILE(HIDKeyboard);
+			sendKeyboard();
+			keyboardChanged = false;
+			D_PERF(outputSent());
 		}
 
-		// Option #4: Last entry in the list
-		if (this == tail) {
-			tail = ptr;  // Set the tail as the previous entry
+		if (mouseChanged) {
+			D_PROFILE(HIDMouse);
+
+			// Split large moves across reports, within the report's range
+			do {
+				int16_t x = constrain(mouseX, -MouseRange, MouseRange);
+				int16_t y = constrain(mouseY, -MouseRange, MouseRange);
+				mouseX -= x;
+				mouseY -= y;
+
+				sendMouse(x, y);
+				D_PERF(outputSent());
+			} while (mouseX != 0 || mouseY != 0);
+
+			mouseChanged = false;
 		}
 	}
 
-	void press(boolean state = true) {
-		if (state == pressed) {
-			return; // Nothing to see here, folks
+private:
+#ifdef CUSTOM_HID
+	struct KeyboardReport {
+		uint8_t modifiers;
+		uint8_t keys[13];  // One bit per key, usages 0x00 - 0x67
+	};
+
+	static const int16_t MouseRange = 32767;  // 16-bit motion
+#else
+	struct KeyboardReport {
+		uint8_t modifiers;
+		uint8_t reserved;
+		uint8_t keys[6];
+	};
+
+	static const int16_t MouseRange = 127;  // 8-bit motion
+#endif
+
+#ifdef TEENSYDUINO
+	static uint8_t getModifier(uint16_t key) {
+		return (key & 0xFF00) == 0xE000 ? key & 0xFF : 0;  // Teensy modifiers are (mask | 0xE000)
+	}
+
+	static uint8_t getUsage(uint16_t key) {
+		if ((key & 0xFF00) == 0xF000) { return key & 0xFF; }  // Teensy keycodes are (usage | 0xF000)
+		return asciiToUsage(key);
+	}
+
+	static void sendKeyboard() {
+		Keyboard.set_modifier(getModifiers());
+		Keyboard.set_key1(keyReport.keys[0]);
+		Keyboard.set_key2(keyReport.keys[1]);
+		Keyboard.set_key3(keyReport.keys[2]);
+		Keyboard.set_key4(keyReport.keys[3]);
+		Keyboard.set_key5(keyReport.keys[4]);
+		Keyboard.set_key6(keyReport.keys[5]);
+		Keyboard.send_now();
+	}
+
+	static void sendMouse(int16_t x, int16_t y) {
+		// Teensy sends the buttons and the motion as separate reports
+		if (mouseButtons != lastMouseButtons) {
+			Mouse.set_buttons(mouseButtons & MOUSE_LEFT, mouseButtons & MOUSE_MIDDLE, mouseButtons & MOUSE_RIGHT);
+			lastMouseButtons = mouseButtons;
+		}
+		if (x != 0 || y != 0) {
+			Mouse.move(x, y);
 		}
+	}
+
+	static uint8_t lastMouseButtons;
+#else
+	static uint8_t getModifier(uint16_t key) {
+		return (key >= 128 && key < 136) ? 1 << (key - 128) : 0;  // Arduino modifiers are (bit + 128)
+	}
+
+	static uint8_t getUsage(uint16_t key) {
+		if (key >= 136) { return key - 136; }  // Arduino keycodes are (usage + 136)
+		return asciiToUsage(key);
+	}
+
+	static void sendKeyboard() {
+		KeyboardReport report = keyReport;
+		report.modifiers = getModifiers();
+		HID().SendReport(KeyboardReportID, &report, sizeof(report));
+	}
+
+	static void sendMouse(int16_t x, int16_t y) {
+		#ifdef CUSTOM_HID
+		uint8_t report[5] = { mouseButtons, (uint8_t) x, (uint8_t) (x >> 8), (uint8_t) y, (uint8_t) (y >> 8) };  // Buttons, X, Y
+		#else
+		uint8_t report[4] = { mouseButtons, (uint8_t) x, (uint8_t) y, 0 };  // Buttons, X, Y, wheel
+		#endif
+		HID().SendReport(MouseReportID, report, sizeof(report));
+	}
+
+	static const uint8_t MouseReportID = 1;  // Same report IDs as the Arduino Mouse and Keyboard libraries
+	static const uint8_t KeyboardReportID = 2;
+#endif
+
+	// US layout, the same as the Arduino Keyboard library. Returns 0 if unsupported.
+	static uint8_t asciiToUsage(uint16_t c) {
+		if (c >= sizeof(AsciiMap)) { return 0; }
+		return pgm_read_byte(AsciiMap + c) & ~AsciiShift;
+	}
 
-		sendState(state);
-		pressed = state;
+	// Whether an ASCII character is typed with shift (uppercase and most symbols)
+	static boolean isShifted(uint16_t c) {
+		if (c >= sizeof(AsciiMap)) { return false; }
+		return pgm_read_byte(AsciiMap + c) & AsciiShift;
+	}
+
+	// Modifiers held by modifier keys, plus shift for shifted characters
+	static uint8_t getModifiers() {
+		return keyReport.modifiers | (shiftedKeys > 0 ? LeftShift : 0);
+	}
+
+	static const uint8_t AsciiShift = 0x80;  // Flag in the ASCII table for characters typed with shift
+	static const uint8_t LeftShift = 0x02;  // Modifier bit
+	static const uint8_t AsciiMap[128];
+
+	static boolean inTransaction;
+
+	static KeyboardReport keyReport;
+	static boolean keyboardChanged;
+	static uint8_t shiftedKeys;  // Number of pressed keys that need shift
+
+	static uint8_t mouseButtons;
+	static int16_t mouseX, mouseY;
+	static boolean mouseChanged;
+};
+
+// Allocate space for the static report data
+boolean HID_Report::inTransaction = false;
+HID_Report::KeyboardReport HID_Report::keyReport = {};
+boolean HID_Report::keyboardChanged = false;
+uint8_t HID_Report::shiftedKeys = 0;
+uint8_t HID_Report::mouseButtons = 0;
+int16_t HID_Report::mouseX = 0;
+int16_t HID_Report::mouseY = 0;
+boolean HID_Report::mouseChanged = false;
+#ifdef TEENSYDUINO
+uint8_t HID_Report::lastMouseButtons = 0;
+#endif
+
+// HID usage for each ASCII character, from the Arduino Keyboard library
+const uint8_t HID_Report::AsciiMap[128] PROGMEM = {
+	// Control characters: backspace, tab, and enter (LF) only
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x2A, 0x2B, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x2C, 0x1E | AsciiShift, 0x34 | AsciiShift, 0x20 | AsciiShift,               // Space ! " #
+	0x21 | AsciiShift, 0x22 | AsciiShift, 0x24 | AsciiShift, 0x34,               // $ % & '
+	0x26 | AsciiShift, 0x27 | AsciiShift, 0x25 | AsciiShift, 0x2E | AsciiShift,  // ( ) * +
+	0x36, 0x2D, 0x37, 0x38,                                                      // , - . /
+	0x27, 0x1E, 0x1F, 0x20,                                                      // 0 1 2 3
+	0x21, 0x22, 0x23, 0x24,                                                      // 4 5 6 7
+	0x25, 0x26, 0x33 | AsciiShift, 0x33,                                         // 8 9 : ;
+	0x36 | AsciiShift, 0x2E, 0x37 | AsciiShift, 0x38 | AsciiShift,               // < = > ?
+	0x1F | AsciiShift, 0x04 | AsciiShift, 0x05 | AsciiShift, 0x06 | AsciiShift,  // @ A B C
+	0x07 | AsciiShift, 0x08 | AsciiShift, 0x09 | AsciiShift, 0x0A | AsciiShift,  // D E F G
+	0x0B | AsciiShift, 0x0C | AsciiShift, 0x0D | AsciiShift, 0x0E | AsciiShift,  // H I J K
+	0x0F | AsciiShift, 0x10 | AsciiShift, 0x11 | AsciiShift, 0x12 | AsciiShift,  // L M N O
+	0x13 | AsciiShift, 0x14 | AsciiShift, 0x15 | AsciiShift, 0x16 | AsciiShift,  // P Q R S
+	0x17 | AsciiShift, 0x18 | AsciiShift, 0x19 | AsciiShift, 0x1A | AsciiShift,  // T U V W
+	0x1B | AsciiShift, 0x1C | AsciiShift, 0x1D | AsciiShift, 0x2F,               // X Y Z [
+	0x31, 0x30, 0x23 | AsciiShift, 0x2D | AsciiShift,                            // \ ] ^ _
+	0x35, 0x04, 0x05, 0x06,                                                      // ` a b c
+	0x07, 0x08, 0x09, 0x0A,                                                      // d e f g
+	0x0B, 0x0C, 0x0D, 0x0E,                                                      // h i j k
+	0x0F, 0x10, 0x11, 0x12,                                                      // l m n o
+	0x13, 0x14, 0x15, 0x16,                                                      // p q r s
+	0x17, 0x18, 0x19, 0x1A,                                                      // t u v w
+	0x1B, 0x1C, 0x1D, 0x2F | AsciiShift,                                         // x y z {
+	0x31 | AsciiShift, 0x30 | AsciiShift, 0x35 | AsciiShift, 0x00,               // | } ~ DEL
+};
+
+#ifdef CUSTOM_HID
+// Key codes from the Arduino Keyboard and Mouse libraries. Other special keys can
+// be used as (usage + 136), e.g. Enter is (0x28 + 136).
+#define KEY_LEFT_CTRL   0x80
+#define KEY_LEFT_SHIFT  0x81
+#define KEY_LEFT_ALT    0x82
+#define KEY_LEFT_GUI    0x83
+#define KEY_RIGHT_CTRL  0x84
+#define KEY_RIGHT_SHIFT 0x85
+#define KEY_RIGHT_ALT   0x86
+#define KEY_RIGHT_GUI   0x87
+
+#define MOUSE_LEFT   1
+#define MOUSE_RIGHT  2
+#define MOUSE_MIDDLE 4
+
+// HID_Descriptor: Adds the mouse and keyboard to the USB HID interface. This has to
+//                 happen before the host asks for the descriptor, so it's done from
+//                 a global constructor like the Arduino libraries. The HID endpoint
+//                 is already polled every 1 ms by the core.
+class HID_Descriptor {
+public:
+	HID_Descriptor();
+
+private:
+	static const uint8_t Data[];
+};
+
+const uint8_t HID_Descriptor::Data[] PROGMEM = {
+	// Mouse: 5 buttons, 16-bit X / Y
+	0x05, 0x01,                                                                  // Usage Page (Generic Desktop)
+	0x09, 0x02,                                                                  // Usage (Mouse)
+	0xA1, 0x01,                                                                  // Collection (Application)
+	0x09, 0x01,                                                                  // Usage (Pointer)
+	0xA1, 0x00,                                                                  // Collection (Physical)
+	0x85, 0x01,                                                                  // Report ID (1)
+	0x05, 0x09,                                                                  // Usage Page (Button)
+	0x19, 0x01,                                                                  // Usage Minimum (1)
+	0x29, 0x05,                                                                  // Usage Maximum (5)
+	0x15, 0x00,                                                                  // Logical Minimum (0)
+	0x25, 0x01,                                                                  // Logical Maximum (1)
+	0x95, 0x05,                                                                  // Report Count (5)
+	0x75, 0x01,                                                                  // Report Size (1)
+	0x81, 0x02,                                                                  // Input (Data, Variable, Absolute)
+	0x95, 0x01,                                                                  // Report Count (1)
+	0x75, 0x03,                                                                  // Report Size (3)
+	0x81, 0x03,                                                                  // Input (Constant), padding
+	0x05, 0x01,                                                                  // Usage Page (Generic Desktop)
+	0x09, 0x30,                                                                  // Usage (X)
+	0x09, 0x31,                                                                  // Usage (Y)
+	0x16, 0x01, 0x80,                                                            // Logical Minimum (-32767)
+	0x26, 0xFF, 0x7F,                                                            // Logical Maximum (32767)
+	0x75, 0x10,                                                                  // Report Size (16)
+	0x95, 0x02,                                                                  // Report Count (2)
+	0x81, 0x06,                                                                  // Input (Data, Variable, Relative)
+	0xC0,                                                                        // End Collection
+	0xC0,                                                                        // End Collection
+
+	// Keyboard: modifiers and a bitmap of keys (n-key rollover)
+	0x05, 0x01,                                                                  // Usage Page (Generic Desktop)
+	0x09, 0x06,                                                                  // Usage (Keyboard)
+	0xA1, 0x01,                                                                  // Collection (Application)
+	0x85, 0x02,                                                                  // Report ID (2)
+	0x05, 0x07,                                                                  // Usage Page (Keyboard)
+	0x19, 0xE0,                                                                  // Usage Minimum (Left Control)
+	0x29, 0xE7,                                                                  // Usage Maximum (Right GUI)
+	0x15, 0x00,                                                                  // Logical Minimum (0)
+	0x25, 0x01,                                                                  // Logical Maximum (1)
+	0x75, 0x01,                                                                  // Report Size (1)
+	0x95, 0x08,                                                                  // Report Count (8)
+	0x81, 0x02,                                                                  // Input (Data, Variable, Absolute)
+	0x19, 0x00,                                                                  // Usage Minimum (0)
+	0x29, 0x67,                                                                  // Usage Maximum (Keypad =)
+	0x95, 0x68,                                                                  // Report Count (104)
+	0x81, 0x02,                                                                  // Input (Data, Variable, Absolute)
+	0xC0,                                                                        // End Collection
+
+	#ifdef GAMEPAD
+	// Gamepad: 16 buttons, 6 signed 8-bit axes
+	0x05, 0x01,                                                                  // Usage Page (Generic Desktop)
+	0x09, 0x05,                                                                  // Usage (Game Pad)
+	0xA1, 0x01,                                                                  // Collection (Application)
+	0x85, 0x03,                                                                  // Report ID (3)
+	0x05, 0x09,                                                                  // Usage Page (Button)
+	0x19, 0x01,                                                                  // Usage Minimum (1)
+	0x29, 0x10,                                                                  // Usage Maximum (16)
+	0x15, 0x00,                                                                  // Logical Minimum (0)
+	0x25, 0x01,                                                                  // Logical Maximum (1)
+	0x75, 0x01,                                                                  // Report Size (1)
+	0x95, 0x10,                                                                  // Report Count (16)
+	0x81, 0x02,                                                                  // Input (Data, Variable, Absolute)
+	0x05, 0x01,                                                                  // Usage Page (Generic Desktop)
+	0x09, 0x30,                                                                  // Usage (X)
+	0x09, 0x31,                                                                  // Usage (Y)
+	0x09, 0x32,                                                                  // Usage (Z)
+	0x09, 0x33,                                                                  // Usage (Rx)
+	0x09, 0x34,                                                                  // Usage (Ry)
+	0x09, 0x35,                                                                  // Usage (Rz)
+	0x15, 0x81,                                                                  // Logical Minimum (-127)
+	0x25, 0x7F,                                                                  // Logical Maximum (127)
+	0x75, 0x08,                                                                  // Report Size (8)
+	0x95, 0x06,                                                                  // Report Count (6)
+	0x81, 0x02,                                                                  // Input (Data, Variable, Absolute)
+	0xC0,                                                                        // End Collection
+	#endif
+};
+
+HID_Descriptor::HID_Descriptor() {
+	static HIDSubDescriptor node(Data, sizeof(Data));
+	HID().AppendDescriptor(&node);
+}
+
+HID_Descriptor HIDDescriptor;
+#endif
+
+// HID_Button: Handles HID button state to prevent input spam. Each button is
+//             registered once at startup and owns one bit in a shared state mask.
+//             Only the bits that changed since the last update are sent.
+class HID_Button {
+public:
+	typedef uint16_t Mask;
+	static const uint8_t MaxButtons = sizeof(Mask) * 8;
+
+	void press(boolean state = true) {
+		if (state) { buttonStates |= Bit; }
+		else { buttonStates &= ~Bit; }
+
+		if (!HID_Report::isInTransaction()) {
+			update();
+			HID_Report::send();
+		}
 	}
 
 	void release() {
 		press(false);
 	}
 
-	// Release all buttons, using the linked list
+	boolean isPressed() const {
+		return buttonStates & Bit;
+	}
+
+	// Release all buttons at once
 	static void releaseAll() {
-		HID_Button * ptr = head;
+		buttonStates = 0;
 
-		while (ptr != nullptr) {
-			ptr->release();
-			ptr = ptr->next;
+		if (!HID_Report::isInTransaction()) {
+			update();
+			HID_Report::send();
 		}
 	}
 
-	const uint16_t key;
-private:
-	static HID_Button * head;
-	static HID_Button * tail;
+	// Write all changed buttons to the HID report
+	static void update() {
+		Mask changed = buttonStates ^ sentStates;
 
-	virtual void sendState(boolean state) = 0;
-	boolean pressed = 0;
-	HID_Button * next = nullptr;
-};
+		for (uint8_t i = 0; changed != 0; i++, changed >>= 1) {
+			if (changed & 1) {
+				Mask bit = (Mask) 1 << i;
+				sendState(i, buttonStates & bit, mouseButtons & bit);
+			}
+		}
 
-// Allocate space for the static pointers
-HID_Button * HID_Button::head = nullptr;
-HID_Button * HID_Button::tail = nullptr;
+		sentStates = buttonStates;
+	}
+
+	// Size of the data shared by all buttons, for the memory report
+	static constexpr size_t sharedSize() {
+		return sizeof(keys) + sizeof(numButtons) + sizeof(mouseButtons) + sizeof(buttonStates) + sizeof(sentStates);
+	}
+
+	const Mask Bit;  // This button's bit in the state masks
+
+protected:
+	HID_Button(uint16_t key, boolean isMouse) : Bit(registerButton(key, isMouse)) {}
 
-// HID_Button: Sending mouse inputs
-class MouseButton : public HID_Button {
-public:
-	using HID_Button::HID_Button;
 private:
-	void sendState(boolean state) {
-		state ? Mouse.press(key) : Mouse.release(key);
+	static Mask registerButton(uint16_t key, boolean isMouse) {
+		if (numButtons >= MaxButtons) {
+			return 0;  // Out of space, button does nothing
+		}
+
+		Mask bit = (Mask) 1 << numButtons;
+		keys[numButtons] = key;
+		if (isMouse) { mouseButtons |= bit; }
+
+		numButtons++;
+		return bit;
+	}
+
+	static void sendState(uint8_t index, boolean state, boolean isMouse) {
+		const uint16_t key = keys[index];
+
+		if (isMouse) {
+			HID_Report::mousePress(key, state);
+		}
+		else {
+			HID_Report::keyboardPress(key, state);
+		}
 
 		#ifdef DEBUG_HID
-		DEBUG_PRINT("Mouse ");
-		switch (key) {
-			case(MOUSE_LEFT):
-				DEBUG_PRINT("left");
-				break;
-			case(MOUSE_RIGHT):
-				DEBUG_PRINT("right");
-				break;
-			case(MOUSE_MIDDLE):
-				DEBUG_PRINT("middle");
-				break;
+		if (isMouse) {
+			DEBUG_PRINT("Mouse ");
+			switch (key) {
+				case(MOUSE_LEFT):
+					DEBUG_PRINT("left");
+					break;
+				case(MOUSE_RIGHT):
+					DEBUG_PRINT("right");
+					break;
+				case(MOUSE_MIDDLE):
+					DEBUG_PRINT("middle");
+					break;
+			}
+		}
+		else {
+			DEBUG_PRINT("Keyboard ");
+			switch (key) {
+				case(KEY_LEFT_SHIFT):
+				case(KEY_RIGHT_SHIFT):
+					DEBUG_PRINT("shift");
+					break;
+				case(' '):
+					DEBUG_PRINT("(space)");
+					break;
+				default:
+					DEBUG_PRINT((char)key);
+					break;
+			}
 		}
 		DEBUG_PRINT(' ');
 		DEBUG_PRINTLN(state ? "pressed" : "released");
 		#endif
 	}
+
+	static uint16_t keys[MaxButtons];  // Key codes, indexed by bit
+	static uint8_t numButtons;  // Number of registered buttons
+
+	static Mask mouseButtons;  // Set bits are mouse buttons, cleared are keyboard keys
+	static Mask buttonStates;  // Current button states
+	static Mask sentStates;  // Button states as of the last update
+};
+
+// Allocate space for the static button data
+uint16_t HID_Button::keys[HID_Button::MaxButtons];
+uint8_t HID_Button::numButtons = 0;
+HID_Button::Mask HID_Button::mouseButtons = 0;
+HID_Button::Mask HID_Button::buttonStates = 0;
+HID_Button::Mask HID_Button::sentStates = 0;
+
+void HID_Report::endTransaction() {
+	HID_Button::update();  // Add the button changes to the report
+	send();
+	inTransaction = false;
+}
+
+// HID_Button: Sending mouse inputs
+class MouseButton : public HID_Button {
+public:
+	MouseButton(uint8_t button) : HID_Button(button, true) {}
 };
 
 // HID_Button: Sending keyboard inputs
 class KeyboardButton : public HID_Button {
 public:
-	using HID_Button::HID_Button;
+	KeyboardButton(uint16_t key) : HID_Button(key, false) {}
+};
+
+#ifdef GAMEPAD
+// HID_Gamepad: Sends every control in one gamepad report, with 16 buttons and 6 axes.
+//              Changes are held until send() is called.
+class HID_Gamepad {
+public:
+	enum Axis : uint8_t { X, Y, Z, RX, RY, RZ, NumAxes };
+
+	static void begin() {
+		#ifdef TEENSYDUINO
+		Joystick.useManualSend(true);
+		#endif
+	}
+
+	static void setButton(uint8_t index, boolean state) {
+		uint16_t bit = 1 << index;
+		uint16_t buttons = state ? report.buttons | bit : report.buttons & ~bit;
+		if (buttons != report.buttons) {
+			report.buttons = buttons;
+			changed = true;
+		}
+	}
+
+	static void setAxis(Axis axis, int8_t value) {
+		if (value != report.axes[axis]) {
+			report.axes[axis] = value;
+			changed = true;
+		}
+	}
+
+	static void send() {
+		if (!changed) { return; }
+		sendReport();
+		changed = false;
+		D_PERF(outputSent());
+	}
+
+	// Release all buttons and center all axes, and send the report
+	static void releaseAll() {
+		if (report.buttons != 0) {
+			report.buttons = 0;
+			changed = true;
+		}
+		for (uint8_t i = 0; i < NumAxes; i++) {
+			setAxis((Axis) i, 0);
+		}
+		send();
+	}
+
 private:
-	void sendState(boolean state) {
-		state ? Keyboard.press(key) : Keyboard.release(key);
+	struct Report {
+		uint16_t buttons;
+		int8_t axes[NumAxes];
+	};
 
-		#ifdef DEBUG_HID
-		DEBUG_PRINT("Keyboard ");
-		switch (key) {
-			case(KEY_LEFT_SHIFT):
-			case(KEY_RIGHT_SHIFT):
-				DEBUG_PRINT("shift");
-				break;
-			case(' '):
-				DEBUG_PRINT("(space)");
-				break;
-			default:
-				DEBUG_PRINT((char)key);
-				break;
+#ifdef TEENSYDUINO
+	static void sendReport() {
+		for (uint8_t i = 0; i < 16; i++) {
+			Joystick.button(i + 1, report.buttons & (1 << i));
 		}
-		DEBUG_PRINT(' ');
-		DEBUG_PRINTLN(state ? "pressed" : "released");
-		#endif
+
+		// Teensy axes are 0-1023
+		Joystick.X(((int16_t) report.axes[X] + 128) * 4);
+		Joystick.Y(((int16_t) report.axes[Y] + 128) * 4);
+		Joystick.Z(((int16_t) report.axes[Z] + 128) * 4);
+		Joystick.Zrotate(((int16_t) report.axes[RZ] + 128) * 4);
+		Joystick.sliderLeft(((int16_t) report.axes[RX] + 128) * 4);
+		Joystick.sliderRight(((int16_t) report.axes[RY] + 128) * 4);
+		Joystick.send_now();
+	}
+#else
+	static void sendReport() {
+		HID().SendReport(ReportID, &report, sizeof(report));  // Little endian, like USB
 	}
+
+	static const uint8_t ReportID = 3;
+#endif
+
+	static Report report;
+	static boolean changed;
 };
 
+HID_Gamepad::Report HID_Gamepad::report = {};
+boolean HID_Gamepad::changed = true;  // Send the first report
+#endif
+
 #endif
@@ -22,16 +22,19 @@
 #define DJLucio_LED_h
 
 #include "DJLucio_Platforms.h"
+#include "DJLucio_Util.h"
+#include "DJLucio_Performance.h"
 
-// SoftwareOscillator: oscillates its state output based on the given period, using the millis() timekeeper
+// SoftwareOscillator: oscillates its state output based on the given period, using the loop time (Frame.ms)
+template<typename Tick = TimerTick>
 class SoftwareOscillator {
 public:
-	boolean getState() {
+	boolean getState(unsigned long t) {
 		if (period != 0) {  // Only oscillate if a period is set
-			unsigned long timeNow = millis();
+			Tick timeNow = t;
 
 			// Toggle output at period
-			if (timeNow - lastFlip >= period) {
+			if (Ticks<Tick>::since(lastFlip, timeNow) >= period) {
 				state = !state;
 				lastFlip = timeNow;
 			}
@@ -67,13 +70,13 @@ public:
 
 private:
 	void reset() {
-		lastFlip = millis();  // Set the timer to ready
+		lastFlip = Frame.ms;  // Set the timer to ready. Loop time, as that's what getState() is given
 		state = LOW;  // Start oscillator on low
 	}
 
 	boolean state;  // State of the oscillator, high or low
-	unsigned long period;  // Period of the oscillation
-	unsigned long lastFlip;  // Timestamp of the last state flip
+	Tick period;  // Period of the oscillation
+	Tick lastFlip;  // Timestamp of the last state flip
 };
 
 // LEDHandler: for dealing with user notifications on the built-in LED
@@ -86,14 +89,16 @@ public:
 		pinMode(Pin, OUTPUT);
 	}
 
-	void update() {
+	void update(const FrameTime &frame) {
+		D_PROFILE(LED);
+
 		if (!currentlyBlinking) {
 			return;  // Nothing to do here
 		}
 
-		setLED(oscillator.getState());  // Write LED based on the blink state
+		setLED(oscillator.getState(frame.ms));  // Write LED based on the blink state
 
-		if (duration != 0 && millis() - patternStart >= duration) {
+		if (duration != 0 && Ticks<TimerTick>::since(patternStart, frame.ms) >= duration) {
 			stopBlinking();  // Blinking is done!
 		}
 	}
@@ -114,7 +119,7 @@ public:
 			return;
 		}
 
-		patternStart = millis();  // Record the time that blinking started
+		patternStart = Frame.ms;  // Record the time that blinking started, on the clock update() uses
 		duration = length;  // Duration to blink, in milliseconds
 		oscillator.setFrequency(hertz);
 		currentlyBlinking = true;
@@ -136,9 +141,9 @@ private:
 	boolean state = LOW;
 
 	boolean currentlyBlinking = false;
-	SoftwareOscillator oscillator;
-	unsigned long duration;
-	unsigned long patternStart;
+	SoftwareOscillator<> oscillator;
+	TimerTick duration;
+	TimerTick patternStart;
 };
 
 LEDHandler LED(LED_Pin, LED_Inverted);  // Default LED instance, using the platform definitions
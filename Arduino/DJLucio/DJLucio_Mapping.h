@@ -0,0 +1,439 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DJLucio_Mapping_h
+#define DJLucio_Mapping_h
+
+#include <NintendoExtensionCtrl.h>
+#include "DJLucio_HID.h"
+#include "DJLucio_Controller.h"
+
+/* Input mappings are built from types, so the compiler can inline the whole
+*  layout into the poll function. There are three kinds:
+*
+*  * Sources:    read a control. Each has a static 'value()' function.
+*  * Transforms: sources that modify other sources (thresholds, logic, etc.)
+*  * Targets:    send a source to the computer. Each has a static 'update()'
+*                function. 'Layout' is a target that updates a list of targets.
+*/
+
+// Controller objects and functions, included in the main sketch
+extern DJTurntableController dj;
+extern DJTurntableController::TurntableExpansion * mainTable;
+extern DJTurntableController::TurntableExpansion * altTable;
+extern EffectHandler fx;
+
+void aiming(int8_t xIn, int8_t yIn);
+
+namespace Mapping {
+
+typedef boolean(DJTurntableController::*BaseFunction)(void) const;
+typedef boolean(DJTurntableController::TurntableExpansion::*ExpansionFunction)(void) const;
+
+// --- Sources ---
+
+// Button on the base station
+template<BaseFunction Fn>
+struct BaseButton {
+	static boolean value() { return (dj.*Fn)(); }
+};
+
+// Button on the main turntable (see TurntableConfig)
+template<ExpansionFunction Fn>
+struct MainButton {
+	static boolean value() { return (mainTable->*Fn)(); }
+};
+
+// Button on the alternate turntable (see TurntableConfig)
+template<ExpansionFunction Fn>
+struct AltButton {
+	static boolean value() { return (altTable->*Fn)(); }
+};
+
+struct JoyX {
+	static uint8_t value() { return dj.joyX(); }
+};
+
+struct JoyY {
+	static uint8_t value() { return dj.joyY(); }
+};
+
+struct Crossfader {
+	static uint8_t value() { return dj.crossfadeSlider(); }
+};
+
+// Effect dial, turned past the threshold clockwise
+template<uint8_t Threshold>
+struct EffectForward {
+	static boolean value() { return fx.changed(Threshold) && fx.getTotal() > 0; }
+};
+
+// Effect dial, turned past the threshold counter-clockwise
+template<uint8_t Threshold>
+struct EffectBackward {
+	static boolean value() { return fx.changed(Threshold) && fx.getTotal() < 0; }
+};
+
+// Platter for a single turntable, on either side
+struct Platter {
+	static int8_t value() { return dj.turntable(); }
+	static boolean isLeft() { return dj.getTurntableConfig() == DJTurntableController::TurntableConfig::Left; }
+};
+
+struct MainPlatter {
+	static int8_t value() { return mainTable->turntable(); }
+	static boolean isLeft() { return mainTable == &dj.left; }
+};
+
+struct AltPlatter {
+	static int8_t value() { return altTable->turntable(); }
+	static boolean isLeft() { return altTable == &dj.left; }
+};
+
+struct EffectDial {
+	static uint8_t value() { return dj.effectDial(); }
+};
+
+struct None {
+	static int8_t value() { return 0; }
+};
+
+// --- Transforms ---
+
+template<class Source>
+struct Not {
+	static boolean value() { return !Source::value(); }
+};
+
+template<class... Sources>
+struct AnyOf;
+
+template<>
+struct AnyOf<> {
+	static boolean value() { return false; }
+};
+
+template<class First, class... Rest>
+struct AnyOf<First, Rest...> {
+	static boolean value() { return First::value() || AnyOf<Rest...>::value(); }
+};
+
+template<class Source, int Threshold>
+struct Above {
+	static boolean value() { return Source::value() > Threshold; }
+};
+
+template<class Source, int Threshold>
+struct Below {
+	static boolean value() { return Source::value() < Threshold; }
+};
+
+// Source if the condition is true, otherwise 0
+template<class Condition, class Source>
+struct Gate {
+	static int8_t value() { return Condition::value() ? Source::value() : 0; }
+};
+
+// Sum of two sources
+template<class A, class B>
+struct Sum {
+	static int8_t value() { return A::value() + B::value(); }
+};
+
+// Source divided by 2^Shift, for fine control. The remainder is carried over to
+// the next update, so slow movements aren't lost.
+template<class Source, uint8_t Shift>
+struct Fine {
+	static int8_t value() {
+		static int16_t residual = 0;  // Leftover from the last update
+
+		const int16_t Divisor = 1 << Shift;
+		int16_t total = residual + Source::value();
+		int8_t out = total / Divisor;  // Rounds towards zero, same in both directions
+		residual = total - out * Divisor;
+		return out;
+	}
+};
+
+// Platter oriented so 'up' is positive. On the left side counter-clockwise is up,
+// on the right side clockwise is up.
+template<class Source>
+struct Vertical {
+	static int8_t value() { return Source::isLeft() ? Source::value() : -Source::value(); }
+};
+
+// Edge between two zones: the lowest reading in the zone above, and how far below
+// that the reading has to go to drop back down
+template<uint8_t Value, uint8_t Hysteresis = 0>
+struct Edge {
+	static const uint8_t Start = Value;
+	static const uint8_t Margin = Hysteresis;
+};
+
+// Zone of an analog source, counting up from 0, with the 'Edge' between each pair of
+// zones. Once a zone is entered the reading has to go past its lower edge by that
+// edge's hysteresis to leave, and a new zone has to hold for the dwell time (ms)
+// before it's used. For example left / center / right, with a wider margin on the
+// right side: Zones<Crossfader, 0, Edge<6, 1>, Edge<10, 2>>
+template<class Source, unsigned long Dwell, class... Edges>
+struct Zones {
+	static uint8_t value() {
+		static const uint8_t EdgeList[] = { Edges::Start... };
+		static const uint8_t Hysteresis[] = { Edges::Margin... };
+		static const uint8_t NumEdges = sizeof...(Edges);
+
+		static uint8_t zone = 0;  // Current zone
+		static uint8_t candidate = 0;  // Zone waiting for the dwell time
+		static unsigned long candidateStart = 0;  // Timestamp for the candidate zone (ms)
+		static uint8_t lastRaw = 0;  // Zone without hysteresis, for counting suppressed changes
+
+		uint8_t input = Source::value();
+
+		uint8_t target = zone;
+		while (target < NumEdges && input >= EdgeList[target]) { target++; }
+		while (target > 0 && input + Hysteresis[target - 1] < EdgeList[target - 1]) { target--; }
+
+		uint8_t raw = 0;
+		while (raw < NumEdges && input >= EdgeList[raw]) { raw++; }
+
+		if (target != candidate) {
+			candidate = target;
+			candidateStart = Frame.ms;
+		}
+
+		uint8_t previous = zone;
+		if (candidate != zone && Frame.ms - candidateStart >= Dwell) {
+			zone = candidate;
+		}
+
+		if (raw != lastRaw) {
+			if (zone == previous) {
+				D_PERF(toggleSuppressed());  // A hard threshold would have changed here
+			}
+			lastRaw = raw;
+		}
+
+		return zone;
+	}
+};
+
+// Whether a 'Zones' source is in the given zone
+template<class ZoneSource, uint8_t Zone>
+struct InZone {
+	static boolean value() { return ZoneSource::value() == Zone; }
+};
+
+// Analog stick with a round dead zone, relative to its center. The center starts at
+// the nominal value and follows the stick while it's resting in the dead zone, to
+// correct for drift. It only follows a reading that's held steady, and only within
+// half the dead zone of nominal, so pushing the stick slowly can't drag it along.
+// This is also a target: add it to a layout before anything that uses it, to read
+// the stick once per update.
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+struct Stick {
+	static const uint8_t Range = Center - 1;  // Farthest reading from the center, on the short side
+
+	static void update() {
+		uint8_t inX = SourceX::value();
+		uint8_t inY = SourceY::value();
+
+		// Count updates without the reading moving more than a count
+		if (abs(inX - lastX) <= 1 && abs(inY - lastY) <= 1) {
+			if (steady < SteadyUpdates) { steady++; }
+		}
+		else {
+			steady = 0;
+		}
+		lastX = inX;
+		lastY = inY;
+
+		int16_t rawX = (int16_t) inX << 4;  // 12.4 fixed point, for a smooth center
+		int16_t rawY = (int16_t) inY << 4;
+
+		int8_t dx = (rawX - centerX + 8) >> 4;  // Rounded to the nearest whole count
+		int8_t dy = (rawY - centerY + 8) >> 4;
+
+		if (dx * dx + dy * dy < Deadzone * Deadzone) {
+			if (steady >= SteadyUpdates) {
+				centerX = track(centerX, rawX);  // Resting, move the center towards it
+				centerY = track(centerY, rawY);
+			}
+			posX = 0;
+			posY = 0;
+		}
+		else {
+			posX = dx;
+			posY = dy;
+		}
+	}
+
+	static int8_t x() { return posX; }
+	static int8_t y() { return posY; }
+
+	// Number of frames out of 'frames' to hold a key, for a distance from the center
+	static uint8_t share(uint8_t amount, uint8_t frames) {
+		uint8_t on = ((uint16_t) amount * frames) / Range;
+		if (on == 0) { on = 1; }
+		return on < frames ? on : frames;
+	}
+
+private:
+	static const uint8_t SteadyUpdates = 16;  // Updates the reading has to hold before the center follows it
+	static const int16_t Nominal = (int16_t) Center << 4;  // 12.4 fixed point
+	static const int16_t MaxDrift = ((int16_t) Deadzone << 4) / 2;  // Farthest the center can move from nominal
+
+	// Moves a center coordinate part of the way towards the reading, within the drift limit
+	static int16_t track(int16_t center, int16_t raw) {
+		center += (raw - center) / 16;
+		return constrain(center, Nominal - MaxDrift, Nominal + MaxDrift);
+	}
+
+	static int16_t centerX, centerY;  // 12.4 fixed point
+	static int8_t posX, posY;  // Distance from the center, 0 in the dead zone
+	static uint8_t lastX, lastY;  // Last reading
+	static uint8_t steady;  // Updates the reading has held, up to 'SteadyUpdates'
+};
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+int16_t Stick<SourceX, SourceY, Center, Deadzone>::centerX = (int16_t) Center << 4;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+int16_t Stick<SourceX, SourceY, Center, Deadzone>::centerY = (int16_t) Center << 4;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+int8_t Stick<SourceX, SourceY, Center, Deadzone>::posX = 0;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+int8_t Stick<SourceX, SourceY, Center, Deadzone>::posY = 0;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+uint8_t Stick<SourceX, SourceY, Center, Deadzone>::lastX = Center;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+uint8_t Stick<SourceX, SourceY, Center, Deadzone>::lastY = Center;
+
+template<class SourceX, class SourceY, uint8_t Center, uint8_t Deadzone>
+uint8_t Stick<SourceX, SourceY, Center, Deadzone>::steady = 0;
+
+// Stick pushed in a direction, 8-way. Pressed within 67.5 degrees of the direction,
+// so the diagonals are the same size as the straight directions.
+template<class StickSource, boolean Horizontal, int8_t Sign>
+struct Push {
+	typedef StickSource Stick;
+
+	static boolean value() {
+		int8_t along = Horizontal ? Stick::x() : Stick::y();
+		int8_t across = Horizontal ? Stick::y() : Stick::x();
+		return along * Sign > 0 && abs(along) * 5 >= abs(across) * 2;  // tan(22.5) ~= 2/5
+	}
+
+	// Distance along the direction
+	static uint8_t amount() {
+		int8_t along = Horizontal ? Stick::x() : Stick::y();
+		return abs(along);
+	}
+};
+
+template<class S> using PushLeft = Push<S, true, -1>;
+template<class S> using PushRight = Push<S, true, 1>;
+template<class S> using PushUp = Push<S, false, 1>;
+template<class S> using PushDown = Push<S, false, -1>;
+
+inline uint16_t frameNumber() {
+	#ifdef USB_FRAME_COUNTER
+	return getUSBFrame();
+	#else
+	return Frame.ms;
+	#endif
+}
+
+// Pulses a Push for part of every 'Frames' USB frames, in proportion to how far the
+// stick is pushed. Update it every frame for the pulses to line up with USB reports.
+// Frames should be a power of 2, so the frame number wraps cleanly.
+template<class Direction, uint8_t Frames>
+struct Pulse {
+	static boolean value() {
+		if (!Direction::value()) {
+			return false;
+		}
+		uint8_t on = Direction::Stick::share(Direction::amount(), Frames);
+		return frameNumber() % Frames < on;
+	}
+};
+
+// --- Targets ---
+
+template<KeyboardButton & Button, class Source>
+struct Key {
+	static void update() { Button.press(Source::value()); }
+};
+
+template<MouseButton & Button, class Source>
+struct Click {
+	static void update() { Button.press(Source::value()); }
+};
+
+template<class SourceX, class SourceY>
+struct Aim {
+	static void update() { aiming(SourceX::value(), SourceY::value()); }
+};
+
+// Target that only updates if the condition is true
+template<class Condition, class Target>
+struct Enable {
+	static void update() { if (Condition::value()) { Target::update(); } }
+};
+
+#ifdef GAMEPAD
+template<uint8_t Index, class Source>
+struct PadButton {
+	static void update() { HID_Gamepad::setButton(Index, Source::value()); }
+};
+
+// Gamepad axis, scaled from the source's range to the full axis. Min can be
+// larger than Max to flip the axis.
+template<HID_Gamepad::Axis A, class Source, int Min, int Max>
+struct PadAxis {
+	static void update() {
+		int32_t value = ((int32_t) (Source::value() - Min) * 254) / (Max - Min) - 127;
+		HID_Gamepad::setAxis(A, constrain(value, -127, 127));
+	}
+};
+#endif
+
+template<class... Targets>
+struct Layout;
+
+template<>
+struct Layout<> {
+	static void update() {}
+};
+
+template<class First, class... Rest>
+struct Layout<First, Rest...> {
+	static void update() {
+		First::update();
+		Layout<Rest...>::update();
+	}
+};
+
+}  // namespace Mapping
+
+#endif
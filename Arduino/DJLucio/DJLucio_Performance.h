@@ -0,0 +1,410 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DJLucio_Performance_h
+#define DJLucio_Performance_h
+
+#include "DJLucio_Util.h"
+
+#if defined(DEBUG_PERFORMANCE) && !defined(DEBUG)
+#error "DEBUG_PERFORMANCE prints through DEBUG, enable both"
+#endif
+
+#if defined(DEBUG_PROFILE) && !defined(DEBUG)
+#error "DEBUG_PROFILE prints through DEBUG, enable both"
+#endif
+
+#if defined(DEBUG_MEMORY) && !defined(DEBUG)
+#error "DEBUG_MEMORY prints through DEBUG, enable both"
+#endif
+
+#ifdef DEBUG_PERFORMANCE
+#define D_PERF(x) Performance.x
+#else
+#define D_PERF(x)
+#endif
+
+#ifdef DEBUG_PROFILE
+#define D_PROFILE(id)  ProfileScope profileScope(ProfileID::id)
+#define D_PROFILER(x)  Profiler::x
+#else
+#define D_PROFILE(id)
+#define D_PROFILER(x)
+#endif
+
+// PerformanceMonitor: Measures the loop rate, the HID output rate, the controller polling
+//                     rate, the aim filter rejections, the analog zone changes
+//                     suppressed by hysteresis, the bus time and error recovery,
+//                     the latency between new controller data and the first HID call
+//                     it causes, and the time from boot / hotplug to the first data
+class PerformanceMonitor {
+public:
+	PerformanceMonitor(unsigned long interval) : reportRate(interval) {}
+
+	void loopStart() {
+		loops++;
+	}
+
+	void pollCompleted() {
+		polls++;
+	}
+
+	void pollSaturated() {
+		saturated++;
+	}
+
+	void aimRejected() {
+		rejected++;
+	}
+
+	void toggleSuppressed() {
+		suppressed++;
+	}
+
+	void busStart() {
+		busStartTime = micros();
+	}
+
+	void busEnd() {
+		busTime += micros() - busStartTime;
+	}
+
+	void busRetry() {
+		retries++;
+	}
+
+	void busRecovery() {
+		recoveries++;
+	}
+
+	void controllerPlugged() {
+		plugTime = millis();
+		waitingForConnect = true;
+		fromBoot = false;
+	}
+
+	void inputReceived() {
+		if (waitingForConnect) {
+			connectTime = millis() - plugTime;
+			waitingForConnect = false;
+			connectTimeReady = true;  // Print on the next report
+		}
+
+		inputTime = micros();
+		waitingForOutput = true;  // Next HID call is timed against this input
+	}
+
+	void outputSent() {
+		hidCalls++;
+
+		if (waitingForOutput) {
+			unsigned long latency = micros() - inputTime;
+
+			latencyTotal += latency;
+			if (latency > latencyMax) { latencyMax = latency; }
+			latencySamples++;
+
+			waitingForOutput = false;
+		}
+	}
+
+	void update(const FrameTime &frame) {
+		unsigned long timeNow = frame.ms;
+		if (!reportRate.ready(timeNow)) {
+			return;  // Not time to report yet
+		}
+
+		if (connectTimeReady) {
+			DEBUG_PRINT(fromBoot ? "PERF: Boot" : "PERF: Hotplug");
+			DEBUG_PRINT(" to first input (ms) ");
+			DEBUG_PRINTLN(connectTime);
+			connectTimeReady = false;
+		}
+
+		unsigned long elapsed = timeNow - periodStart;
+		if (elapsed == 0) { elapsed = 1; }  // Avoiding div/0 on first call
+
+		DEBUG_PRINT("PERF: Loops/s ");
+		DEBUG_PRINT((loops * 1000UL) / elapsed);
+		DEBUG_PRINT(" | HID/s ");
+		DEBUG_PRINT((hidCalls * 1000UL) / elapsed);
+		DEBUG_PRINT(" | Polls/s ");
+		DEBUG_PRINT((polls * 1000UL) / elapsed);
+		DEBUG_PRINT(" | Saturated ");
+		DEBUG_PRINT(saturated);
+		DEBUG_PRINT(" | Rejected ");
+		DEBUG_PRINT(rejected);
+		DEBUG_PRINT(" | Suppressed ");
+		DEBUG_PRINT(suppressed);
+		DEBUG_PRINT(" | Bus blocked (us/s) ");
+		DEBUG_PRINT((busTime * 1000UL) / elapsed);
+		DEBUG_PRINT(" | Retries ");
+		DEBUG_PRINT(retries);
+		DEBUG_PRINT(" | Recoveries ");
+		DEBUG_PRINT(recoveries);
+		DEBUG_PRINT(" | Latency (us) avg ");
+		DEBUG_PRINT(latencySamples != 0 ? latencyTotal / latencySamples : 0);
+		DEBUG_PRINT(" max ");
+		DEBUG_PRINTLN(latencyMax);
+
+		periodStart = timeNow;
+		loops = 0;
+		hidCalls = 0;
+		polls = 0;
+		saturated = 0;
+		rejected = 0;
+		suppressed = 0;
+		busTime = 0;
+		retries = 0;
+		recoveries = 0;
+		latencyTotal = 0;
+		latencyMax = 0;
+		latencySamples = 0;
+	}
+
+private:
+	RateLimiter<> reportRate;  // How often to print results
+	unsigned long periodStart = 0;  // Timestamp for the start of the current reporting period
+
+	unsigned long loops = 0;  // Number of loop() iterations this period
+	unsigned long hidCalls = 0;  // Number of HID reports sent this period
+	unsigned long polls = 0;  // Number of controller polls this period
+	unsigned long saturated = 0;  // Number of polls with the aim input at or past the max
+	unsigned long rejected = 0;  // Number of aim readings rejected as spurious
+	unsigned long suppressed = 0;  // Number of analog zone changes held back by hysteresis
+	unsigned long busTime = 0;  // Time spent waiting on the I2C bus this period (us)
+	unsigned long busStartTime = 0;  // Timestamp for the start of the current bus transfer (us)
+	unsigned long retries = 0;  // Number of failed reads that were retried
+	unsigned long recoveries = 0;  // Number of bus resets
+
+	unsigned long plugTime = 0;  // Timestamp for the controller being plugged in, 0 for boot (ms)
+	unsigned long connectTime = 0;  // Time from plugging in (or boot) to the first controller data (ms)
+	boolean waitingForConnect = true;  // Whether the first data since plugging in has arrived
+	boolean connectTimeReady = false;  // Whether there's a new connection time to print
+	boolean fromBoot = true;  // Whether the connection time is from boot or from a hotplug
+
+	unsigned long inputTime = 0;  // Timestamp for the last new controller data, in microseconds
+	boolean waitingForOutput = false;  // Whether the latest input has caused a HID call yet
+
+	unsigned long latencyTotal = 0;  // Sum of all latency samples this period (us)
+	unsigned long latencyMax = 0;  // Largest latency sample this period (us)
+	unsigned long latencySamples = 0;  // Number of latency samples this period
+};
+
+#ifdef DEBUG_PERFORMANCE
+PerformanceMonitor Performance(1000);  // Report once per second
+#endif
+
+#ifdef DEBUG_MEMORY
+#ifdef __AVR__
+extern "C" char __heap_start;  // Start of the heap, from the linker
+extern "C" char * __brkval;  // End of the heap, 'nullptr' until the first malloc()
+#else
+extern "C" char * sbrk(int incr);
+#endif
+
+// MemoryReport: Prints the RAM used by each part of the program, and the space left
+//               between the heap and the stack. Flash use is in the build output,
+//               see the README.
+namespace MemoryReport {
+	inline void item(const char * name, size_t bytes) {
+		DEBUG_PRINT("MEM: ");
+		DEBUG_PRINT(name);
+		DEBUG_PRINT(" | ");
+		DEBUG_PRINT((unsigned long) bytes);
+		DEBUG_PRINTLN(" bytes");
+	}
+
+	inline long freeRAM() {
+		char top;  // Current end of the stack
+		#ifdef __AVR__
+		return &top - (__brkval == nullptr ? &__heap_start : __brkval);
+		#else
+		return &top - sbrk(0);
+		#endif
+	}
+
+	inline void remaining() {
+		DEBUG_PRINT("MEM: Free | ");
+		DEBUG_PRINT(freeRAM());
+		DEBUG_PRINTLN(" bytes");
+	}
+}
+#endif
+
+// Named sections of the program for the profiler
+enum class ProfileID : uint8_t {
+	Poll,          // ConnectionHelper::isReady()
+	DJController,  // djController()
+	Effects,       // EffectHandler::update()
+	Config,        // TurntableConfig::check()
+	LED,           // LEDHandler::update()
+	HIDKeyboard,   // Keyboard report
+	HIDMouse,      // Mouse report(s)
+	NumScopes,
+};
+
+#ifdef DEBUG_PROFILE
+
+// CycleCounter: Fastest available clock for each platform
+#if defined(KINETISK)  // Teensy 3.x, DWT cycle counter
+class CycleCounter {
+public:
+	typedef uint32_t Ticks;
+	static const uint8_t CyclesPerTick = 1;
+
+	static void begin() {
+		ARM_DEMCR |= ARM_DEMCR_TRCENA;
+		ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+	}
+
+	static Ticks now() {
+		return ARM_DWT_CYCCNT;
+	}
+};
+#elif defined(__AVR__)  // Timer1, free running at F_CPU / 8
+class CycleCounter {
+public:
+	typedef uint16_t Ticks;
+	static const uint8_t CyclesPerTick = 8;  // Wraps after 32 ms at 16 MHz
+
+	static void begin() {
+		TCCR1A = 0;
+		TCCR1B = (1 << CS11);  // Prescaler 8
+	}
+
+	static Ticks now() {
+		return TCNT1;
+	}
+};
+#else  // Teensy LC, no cycle counter
+class CycleCounter {
+public:
+	typedef uint32_t Ticks;
+	static const uint8_t CyclesPerTick = F_CPU / 1000000;
+
+	static void begin() {}
+
+	static Ticks now() {
+		return micros();
+	}
+};
+#endif
+
+// Profiler: Keeps the min/max/mean time for each named section, with a histogram.
+//           Send 'p' over serial to print and reset the results.
+class Profiler {
+public:
+	static void begin() {
+		CycleCounter::begin();
+		reset();
+	}
+
+	static void update() {
+		if (Serial.available() && Serial.read() == 'p') {
+			dump();
+			reset();
+		}
+	}
+
+	static void record(ProfileID id, uint32_t cycles) {
+		Stats & s = stats[(uint8_t) id];
+
+		if (s.count == 0 || cycles < s.min) { s.min = cycles; }
+		if (cycles > s.max) { s.max = cycles; }
+		s.total += cycles;
+		s.count++;
+
+		// Buckets are powers of 4: 0-3, 4-15, 16-63, ...
+		uint8_t bucket = 0;
+		while (cycles >= 4 && bucket < NumBuckets - 1) {
+			cycles >>= 2;
+			bucket++;
+		}
+		if (s.buckets[bucket] != 0xFFFF) { s.buckets[bucket]++; }  // Don't overflow
+	}
+
+	static void dump() {
+		DEBUG_PRINTLN("PROF: name, count, min, mean, max (cycles), histogram (x4 buckets from 0)");
+		for (uint8_t i = 0; i < NumScopes; i++) {
+			const Stats & s = stats[i];
+			DEBUG_PRINT("PROF: ");
+			DEBUG_PRINT(Names[i]);
+			DEBUG_PRINT(", ");
+			DEBUG_PRINT(s.count);
+			DEBUG_PRINT(", ");
+			DEBUG_PRINT(s.min);
+			DEBUG_PRINT(", ");
+			DEBUG_PRINT(s.count != 0 ? s.total / s.count : 0);
+			DEBUG_PRINT(", ");
+			DEBUG_PRINT(s.max);
+			DEBUG_PRINT(",");
+			for (uint8_t b = 0; b < NumBuckets; b++) {
+				DEBUG_PRINT(' ');
+				DEBUG_PRINT(s.buckets[b]);
+			}
+			DEBUG_PRINTLN();
+			DEBUG_FLUSH();  // Too much for the log queue at once, wait for it to send
+		}
+	}
+
+	static void reset() {
+		memset(stats, 0, sizeof(stats));
+	}
+
+private:
+	static const uint8_t NumScopes = (uint8_t) ProfileID::NumScopes;
+	static const uint8_t NumBuckets = 8;
+
+	struct Stats {
+		uint32_t min;
+		uint32_t max;
+		uint32_t total;
+		uint32_t count;
+		uint16_t buckets[NumBuckets];
+	};
+
+	static Stats stats[NumScopes];
+	static const char * const Names[NumScopes];
+};
+
+Profiler::Stats Profiler::stats[Profiler::NumScopes];
+const char * const Profiler::Names[Profiler::NumScopes] = {
+	"isReady", "djController", "fx.update", "config.check", "LED.update", "HID keyboard", "HID mouse",
+};
+
+// ProfileScope: Times a section of code, from construction to the end of its scope
+class ProfileScope {
+public:
+	ProfileScope(ProfileID i) : id(i), start(CycleCounter::now()) {}
+
+	~ProfileScope() {
+		CycleCounter::Ticks elapsed = CycleCounter::now() - start;
+		Profiler::record(id, (uint32_t) elapsed * CycleCounter::CyclesPerTick);
+	}
+
+private:
+	const ProfileID id;
+	const CycleCounter::Ticks start;
+};
+
+#endif  // DEBUG_PROFILE
+
+#endif
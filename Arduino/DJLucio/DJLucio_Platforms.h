@@ -30,11 +30,27 @@
 *  * DetectPin:    pin for detecting whether the controller is
 *                  connected. Typically the next pin after the
 *                  I2C pins. Requires an external pull-down.
+*  * DetectPin2:   detect pin for the second controller on the
+*                  multiplexer (CONTROLLER_MUX). Not an I2C pin.
+*
+*  * SDA_Pin:      I2C data pin, for clearing a stuck bus
+*  * SCL_Pin:      I2C clock pin, for clearing a stuck bus
 *
 *  * SafetyPin:    last-resort pin to recover the microcontroller
 *                  in case of a programming error. Ground this pin to
 *                  halt execution at program start. Typically the Last
 *                  pin on the left side of the controller.
+*
+*  Boards with a readable USB frame number should also define:
+*
+*  * USB_FRAME_COUNTER: flag that the board can read its USB frame number
+*  * getUSBFrame():     returns the current USB frame number. Increments
+*                       once per start-of-frame packet (1 ms, full speed)
+*
+*  And each architecture defines:
+*
+*  * sleepCPU():        halts the CPU until the next interrupt, with
+*                       the timers and USB still running
 */
 
 #if defined(__AVR_ATmega32U4__)
@@ -44,25 +60,37 @@
 const uint8_t LED_Pin = 17;  // RX LED on the Pro Micro
 const boolean LED_Inverted = true;  // Inverted on the Pro Micro (LOW is lit)
 
-const uint8_t DetectPin = 4;  // SDA 2, SCL 3
+const uint8_t DetectPin = 4;
+const uint8_t DetectPin2 = 5;
 const uint8_t SafetyPin = 9;
 
+const uint8_t SDA_Pin = 2;
+const uint8_t SCL_Pin = 3;
+
 // Arduino Leonardo
 #elif defined(ARDUINO_AVR_LEONARDO)
 const uint8_t LED_Pin = 13;
 const boolean LED_Inverted = false;
 
-const uint8_t DetectPin = 4;  // SDA 2, SCL 3
+const uint8_t DetectPin = 4;
+const uint8_t DetectPin2 = 5;
 const uint8_t SafetyPin = 12;
 
+const uint8_t SDA_Pin = 2;
+const uint8_t SCL_Pin = 3;
+
 // Teensy 2.0
 #elif defined(CORE_TEENSY)
 const uint8_t LED_Pin = 11;
 const boolean LED_Inverted = false;
 
-const uint8_t DetectPin = 7;  // SCL 5, SDA 6
+const uint8_t DetectPin = 7;
+const uint8_t DetectPin2 = 8;
 const uint8_t SafetyPin = 10;
 
+const uint8_t SDA_Pin = 6;
+const uint8_t SCL_Pin = 5;
+
 #endif  // 32U4 boards
 
 // Teensy 2.0++
@@ -70,16 +98,24 @@ const uint8_t SafetyPin = 10;
 const uint8_t LED_Pin = 6;
 const boolean LED_Inverted = false;
 
-const uint8_t DetectPin = 2;  // SCL 0, SDA 1
+const uint8_t DetectPin = 2;
+const uint8_t DetectPin2 = 3;
 const uint8_t SafetyPin = 17;
 
+const uint8_t SDA_Pin = 1;
+const uint8_t SCL_Pin = 0;
+
 // Teensy 3.0/3.1-3.2/LC/3.5/3.6
 #elif (defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__) || \
        defined(__MK64FX512__) || defined(__MK66FX1M0__)) && defined(CORE_TEENSY)
 const uint8_t LED_Pin = 13;
 const boolean LED_Inverted = false;
 
-const uint8_t DetectPin = 17;  // SCL 19, SDA 18
+const uint8_t DetectPin = 17;
+const uint8_t DetectPin2 = 16;
+
+const uint8_t SDA_Pin = 18;
+const uint8_t SCL_Pin = 19;
 
 // --- Teensy Short boards (3.0 / 3.1-3.2 / LC)
 #if defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)  
@@ -94,6 +130,37 @@ const uint8_t SafetyPin = 32;
 #error Unsupported board! Use a Leonardo, Pro Micro, or Teensy
 #endif
 
+// USB frame number, from the USB controller's registers
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_AT90USB1286__)
+#define USB_FRAME_COUNTER
+inline uint16_t getUSBFrame() {
+	uint8_t low = UDFNUML;  // Read low byte first
+	return (UDFNUMH << 8) | low;
+}
+
+#elif defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__) || \
+      defined(__MK64FX512__) || defined(__MK66FX1M0__)
+#define USB_FRAME_COUNTER
+inline uint16_t getUSBFrame() {
+	uint8_t low = USB0_FRMNUML;
+	return (USB0_FRMNUMH << 8) | low;
+}
+#endif
+
+// Low power idle, woken by any interrupt (millis() tick, USB start of frame, etc.)
+#if defined(__AVR__)
+#include <avr/sleep.h>
+inline void sleepCPU() {
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_mode();
+}
+
+#elif defined(__arm__)
+inline void sleepCPU() {
+	asm volatile("wfi");
+}
+#endif
+
 // Check Teensy USB type setting
 #if defined(TEENSYDUINO)
 #if !defined(USB_HID) && !defined(USB_SERIAL_HID) && !defined(USB_HID_TOUCHSCREEN)
@@ -22,19 +22,223 @@
 #define DJLucio_Util_h
 
 #ifdef DEBUG
-#define DEBUG_PRINT(x)   do {Serial.print(x);}   while(0)
-#define DEBUG_PRINTLN(x) do {Serial.println(x);} while(0)
+#define DEBUG_PRINT(x)   do {DebugLog.print(x);}   while(0)
+#define DEBUG_PRINTLN(x) do {DebugLog.println(x);} while(0)
+#define DEBUG_PRINTHEX(x) do {DebugLog.printHex(x);} while(0)
+#define DEBUG_UPDATE()   do {DebugLog.update();}   while(0)
+#define DEBUG_FLUSH()    do {DebugLog.flush();}    while(0)
 #else
 #define DEBUG_PRINT(x)
 #define DEBUG_PRINTLN(x)
+#define DEBUG_PRINTHEX(x)
+#define DEBUG_UPDATE()
+#define DEBUG_FLUSH()
 #endif
 
+#ifdef DEBUG
+
+/* Debug log format: the records are sent as they're queued, as binary, and turned
+*  back into text on the PC with Host/build/log-decode (see Host/README.md). The
+*  stream starts on a record boundary.
+*
+*  * Type (1 byte), then its data:
+*      1 String:   the characters, then a 0
+*      2 Char:     1 byte
+*      3 Signed:   4 bytes, little endian
+*      4 Unsigned: 4 bytes, little endian
+*      5 Hex:      1 byte, shown as two hex digits
+*      6 Newline:  nothing
+*      7 Dropped:  4 bytes, little endian. Number of records dropped before this
+*/
+
+// DebugLogger: Queues debug prints as small binary records instead of writing them
+//              to serial right away, so debug builds keep the same loop timing. The
+//              records are sent as binary in update(), with no formatting on the
+//              board, and only as much as fits in the serial buffer is sent per call,
+//              so it never blocks. If the queue is full new records are dropped, and
+//              the number dropped is sent later. Strings are stored by pointer, so
+//              only use string literals.
+class DebugLogger {
+public:
+	void print(const char * str) { push(Record::String).str = str; }
+	void print(char c) { push(Record::Char).c = c; }
+	void print(signed char n) { print((long) n); }
+	void print(unsigned char n) { print((unsigned long) n); }
+	void print(int n) { print((long) n); }
+	void print(unsigned int n) { print((unsigned long) n); }
+	void print(long n) { push(Record::Signed).n = n; }
+	void print(unsigned long n) { push(Record::Unsigned).u = n; }
+	void printHex(uint8_t b) { push(Record::Hex).c = b; }  // Two digits
+
+	template<typename T>
+	void println(T x) {
+		print(x);
+		println();
+	}
+
+	void println() { push(Record::Newline); }
+
+	// Sends queued records to serial, as far as the serial buffer allows
+	void update() {
+		if (dropped != 0 && free() >= 1) {
+			unsigned long n = dropped;  // Push can't drop this, there's room
+			dropped = 0;
+			push(Record::Dropped).u = n;
+		}
+
+		uint8_t buffer[32];  // Sent in one write, single bytes are slow over USB
+		int space = Serial.availableForWrite();
+		if (space > (int) sizeof(buffer)) { space = sizeof(buffer); }
+
+		int length = 0;
+		while (length < space) {
+			if (outIndex < outLength) {
+				buffer[length++] = out[outIndex++];
+			}
+			else if (str != nullptr) {
+				char c = *str++;
+				buffer[length++] = c;
+				if (c == '\0') { str = nullptr; }  // Terminator sent, string's done
+			}
+			else if (!next()) {
+				break;  // Nothing left to send
+			}
+		}
+
+		if (length != 0) {
+			Serial.write(buffer, length);
+		}
+	}
+
+	// Sends everything in the queue, waiting for serial if necessary
+	void flush() {
+		while (outIndex < outLength || str != nullptr || head != tail) {
+			update();
+		}
+	}
+
+private:
+	static const uint8_t Size = 64;  // Number of records, power of 2
+
+	struct Record {
+		enum Type : uint8_t { String = 1, Char, Signed, Unsigned, Hex, Newline, Dropped } type;
+		union {
+			const char * str;
+			char c;
+			long n;
+			unsigned long u;
+		};
+	};
+
+	uint8_t free() const {
+		return Size - 1 - (uint8_t) (head - tail) % Size;
+	}
+
+	// Adds a record to the queue, or to a scratch record if the queue is full
+	Record & push(Record::Type type) {
+		uint8_t nextHead = (head + 1) % Size;
+		if (nextHead == tail) {
+			dropped++;
+			return scratch;  // Full, throw it away
+		}
+		Record & r = records[head];
+		r.type = type;
+		head = nextHead;  // Written last, in case update() runs from an interrupt
+		return r;
+	}
+
+	// Takes the next record from the queue and encodes it for output
+	boolean next() {
+		if (tail == head) {
+			return false;  // Empty
+		}
+		const Record & r = records[tail];
+
+		out[0] = r.type;
+		outLength = 1;
+		outIndex = 0;
+
+		switch (r.type) {
+			case(Record::String):
+				str = r.str;  // Sent straight from the string
+				break;
+			case(Record::Char):
+			case(Record::Hex):
+				out[outLength++] = r.c;
+				break;
+			case(Record::Signed):
+			case(Record::Unsigned):
+			case(Record::Dropped):
+				for (uint8_t i = 0; i < 4; i++) {
+					out[outLength++] = (uint32_t) r.u >> (i * 8);  // Same bits for signed
+				}
+				break;
+			case(Record::Newline):
+				break;
+		}
+
+		tail = (tail + 1) % Size;
+		return true;
+	}
+
+	Record records[Size];
+	Record scratch;  // Target for records that don't fit
+	volatile uint8_t head = 0;  // Next record to write
+	volatile uint8_t tail = 0;  // Next record to send
+	unsigned long dropped = 0;  // Number of records dropped since the last report
+
+	uint8_t out[5];  // Encoded record being sent, before any string
+	uint8_t outLength = 0;
+	uint8_t outIndex = 0;  // Next byte of 'out' to send
+	const char * str = nullptr;  // String left to send for the current record
+};
+
+DebugLogger DebugLog;
+
+#endif
+
+// FrameTime: The clock, read once at the start of each loop() and passed to the parts
+//            of the program that run in it. They all see the same time, and a run
+//            can be replayed exactly from a recording of the inputs and times.
+struct FrameTime {
+	void update() {
+		ms = millis();
+	}
+
+	unsigned long ms = 0;  // Time at the start of the loop (ms)
+};
+
+FrameTime Frame;  // Current loop's time
+
+// Timestamp width for the timing classes. Their timestamps are the low bits of
+// millis(), so each one only takes this much RAM. 16 bits can time up to 32 s.
+typedef uint16_t TimerTick;
+
+// Ticks: Clock helpers for a given timestamp width. Elapsed times are cast back to
+//        the width before comparing, so they stay correct as millis() wraps around.
+template<typename Tick>
+struct Ticks {
+	static const Tick Max = (Tick) ~((Tick) 0);
+	static const Tick Limit = Max / 2;  // Longest time that can be measured safely
+
+	static Tick now() {
+		return (Tick) millis();
+	}
+
+	static Tick since(Tick start, Tick timeNow) {
+		return (Tick) (timeNow - start);
+	}
+};
+
 // RateLimiter: Simple timekeeper that returns 'true' if X time has passed.
-//              Uses millis() as its clock.
+//              Uses millis() as its clock, or the time passed in. If it isn't
+//              checked for longer than a full wrap of the timestamp it may wait
+//              an extra period.
+template<typename Tick = TimerTick>
 class RateLimiter {
 public:
-	RateLimiter(unsigned long rate) : UpdateRate(rate) {
-		lastUpdate = millis() - rate;  // Guarantee 'ready' on first call 
+	RateLimiter(Tick rate) : UpdateRate(rate) {
+		lastUpdate = Ticks<Tick>::now() - rate;  // Guarantee 'ready' on first call 
 	}
 
 	boolean ready() {
@@ -42,7 +246,7 @@ public:
 	}
 
 	boolean ready(unsigned long timeNow) {
-		if (timeNow - lastUpdate >= UpdateRate) {
+		if (Ticks<Tick>::since(lastUpdate, timeNow) >= UpdateRate) {
 			lastUpdate = timeNow;
 			return true;
 		}
@@ -50,28 +254,81 @@ public:
 	}
 
 	void reset() {
-		lastUpdate = millis();
+		reset(millis());
+	}
+
+	void reset(unsigned long timeNow) {
+		lastUpdate = timeNow;
+	}
+
+	const Tick UpdateRate = 0;  // Rate limit, in ms
+private:
+	Tick lastUpdate;
+};
+
+// Backoff: RateLimiter where the wait time doubles after every failure, up to a max.
+//          Uses millis() as its clock, or the time passed in.
+template<typename Tick = TimerTick>
+class Backoff {
+public:
+	Backoff(Tick minRate, Tick maxRate) : MinRate(minRate), MaxRate(maxRate), rate(minRate) {
+		lastAttempt = Ticks<Tick>::now() - minRate;  // Guarantee 'ready' on first call
+	}
+
+	boolean ready() {
+		return ready(millis());
+	}
+
+	boolean ready(unsigned long timeNow) {
+		if (Ticks<Tick>::since(lastAttempt, timeNow) >= rate) {
+			lastAttempt = timeNow;
+			return true;
+		}
+		return false;
+	}
+
+	void failed() {
+		rate = (rate < MaxRate / 2) ? rate * 2 : MaxRate;
+	}
+
+	void reset() {
+		rate = MinRate;
 	}
 
-	const unsigned long UpdateRate = 0;  // Rate limit, in ms
+	const Tick MinRate;  // Wait after a success, in ms
+	const Tick MaxRate;  // Longest wait after failures, in ms
 private:
-	unsigned long lastUpdate;
+	Tick rate;  // Current wait time, in ms
+	Tick lastAttempt;
 };
 
-// HeldFor: Checks how long a two-state variable has been in a given state
+// HeldFor: Checks how long a two-state variable has been in a given state.
+//          The time stops counting at the tick width's safe limit.
+template<typename Tick = TimerTick>
 class HeldFor {
 public:
 	HeldFor(boolean goalState) : HeldFor(goalState, !goalState) {}
 	HeldFor(boolean goalState, boolean setInitial)
 		: MatchState(goalState), lastState(setInitial) {}
 
-	unsigned long check(boolean state) {
+	Tick check(boolean state) {
+		return check(state, millis());
+	}
+
+	Tick check(boolean state, unsigned long t) {
 		if (state == MatchState) {
+			Tick timeNow = t;
 			if (lastState == !MatchState) {  // This is new!
-				stableSince = millis();  // Reset the stable counter
+				stableSince = timeNow;  // Reset the stable counter
 			}
 			lastState = state;  // Save for future reference
-			return millis() - stableSince;  // How long we've been stable
+
+			Tick held = Ticks<Tick>::since(stableSince, timeNow);
+			if (held > Ticks<Tick>::Limit) {
+				held = Ticks<Tick>::Limit;
+				stableSince = timeNow - held;  // Hold at the limit, before it wraps
+			}
+			return held;  // How long we've been stable
 		}
 
 		lastState = state;
@@ -81,7 +338,7 @@ public:
 private:
 	const boolean MatchState;  // The state we're looking for
 	boolean lastState;  // Last recorded state
-	unsigned long stableSince;  // Timestamp for edge change
+	Tick stableSince;  // Timestamp for edge change
 };
 
 #endif
@@ -0,0 +1,111 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Converts a DEBUG_CAPTURE stream (see DJLucio_Capture.h) to CSV, or to trace lines
+// that replay the control data in the simulator.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+const uint8_t FrameSize = 6;
+const uint8_t LongTime = 1 << 6;
+const uint8_t Restart = 1 << 7;
+
+static void usage() {
+	printf("Usage: capture-convert [-c] [-t offset] capture.bin\n");
+	printf("  -c  write CSV (time, restart, 6 data bytes) instead of trace lines\n");
+	printf("  -t  add an offset to every time, in ms\n");
+}
+
+int main(int argc, char * argv[]) {
+	bool csv = false;
+	unsigned long offset = 0;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		std::string opt = argv[i];
+		if (opt == "-c") { csv = true; }
+		else if (opt == "-t" && i + 1 < argc) { offset = strtoul(argv[++i], nullptr, 10); }
+		else { usage(); return 2; }
+	}
+	if (i != argc - 1) { usage(); return 2; }
+
+	FILE * in = fopen(argv[i], "rb");
+	if (in == nullptr) {
+		fprintf(stderr, "Can't open '%s'\n", argv[i]);
+		return 2;
+	}
+
+	if (csv) {
+		printf("time_ms,restart,b0,b1,b2,b3,b4,b5\n");
+	}
+	else {
+		printf("# Converted from %s\n", argv[i]);
+	}
+
+	uint8_t frame[FrameSize] = {};
+	unsigned long time = offset;
+	unsigned long records = 0;
+
+	int header;
+	while ((header = fgetc(in)) != EOF) {
+		int lo = fgetc(in);
+		int hi = (header & LongTime) ? fgetc(in) : 0;
+		if (lo == EOF || hi == EOF) {
+			fprintf(stderr, "Record %lu: cut off in the time\n", records);
+			return 1;
+		}
+		time += lo | (hi << 8);
+
+		if (header & Restart) {
+			memset(frame, 0, sizeof(frame));
+		}
+
+		for (uint8_t b = 0; b < FrameSize; b++) {
+			if (header & (1 << b)) {
+				int data = fgetc(in);
+				if (data == EOF) {
+					fprintf(stderr, "Record %lu: cut off in the data\n", records);
+					return 1;
+				}
+				frame[b] = data;
+			}
+		}
+
+		if (csv) {
+			printf("%lu,%d", time, (header & Restart) ? 1 : 0);
+			for (uint8_t b = 0; b < FrameSize; b++) { printf(",%u", frame[b]); }
+			printf("\n");
+		}
+		else {
+			if (header & Restart) { printf("# Restart, records may be missing before this\n"); }
+			printf("@%lu raw", time);
+			for (uint8_t b = 0; b < FrameSize; b++) { printf(" %02X", frame[b]); }
+			printf("\n");
+		}
+		records++;
+	}
+
+	fclose(in);
+	fprintf(stderr, "%lu records, %lu ms\n", records, time - offset);
+	return 0;
+}
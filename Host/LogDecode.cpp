@@ -0,0 +1,72 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Turns a debug log from a DEBUG build of the sketch (see DebugLogger in
+// DJLucio_Util.h) back into text. Reads a file, or the serial port as it runs.
+
+#include <stdio.h>
+#include <string>
+
+#include "LogDecoder.h"
+
+static void usage() {
+	printf("Usage: log-decode [log.bin]\n");
+	printf("  reads from stdin without a file, e.g. 'log-decode < /dev/ttyACM0'\n");
+}
+
+int main(int argc, char * argv[]) {
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+		usage();
+		return 2;
+	}
+
+	FILE * in = stdin;
+	if (argc == 2) {
+		in = fopen(argv[1], "rb");
+		if (in == nullptr) {
+			fprintf(stderr, "Can't open '%s'\n", argv[1]);
+			return 2;
+		}
+	}
+
+	Host::LogDecoder decoder;
+	std::string text;
+
+	int c;
+	while ((c = fgetc(in)) != EOF) {
+		decoder.feed(c, text);
+		if (!text.empty()) {
+			fputs(text.c_str(), stdout);
+			fflush(stdout);  // Keep up with a live port
+			text.clear();
+		}
+	}
+
+	if (in != stdin) { fclose(in); }
+
+	if (decoder.partial()) {
+		fprintf(stderr, "Log ends partway through a record\n");
+	}
+	if (decoder.errors != 0) {
+		fprintf(stderr, "%lu bytes weren't part of a record\n", decoder.errors);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef Host_LogDecoder_h
+#define Host_LogDecoder_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace Host {
+
+// LogDecoder: Turns the sketch's binary debug log (see DebugLogger in DJLucio_Util.h)
+//             back into the text it was printed as, a byte at a time
+class LogDecoder {
+public:
+	enum Type : uint8_t { None, String, Char, Signed, Unsigned, Hex, Newline, Dropped };
+
+	// Decodes one byte of the stream, adding any text it completes to 'text'
+	void feed(uint8_t byte, std::string &text) {
+		if (type == None) {
+			if (byte < String || byte > Dropped) {
+				errors++;  // Not a record, skip it
+				return;
+			}
+			type = (Type) byte;
+			length = 0;
+			if (type == Newline) {
+				text += "\r\n";
+				type = None;
+			}
+			return;
+		}
+
+		switch (type) {
+			case(String):
+				if (byte == 0) { type = None; }
+				else { text += (char) byte; }
+				return;
+			case(Char):
+				text += (char) byte;
+				break;
+			case(Hex):
+				text += hexDigit(byte >> 4);
+				text += hexDigit(byte & 0x0F);
+				break;
+			default:  // 4 byte numbers
+				data[length++] = byte;
+				if (length < 4) { return; }
+				number(text);
+				break;
+		}
+		type = None;
+	}
+
+	// Whether the stream stopped partway through a record
+	bool partial() const {
+		return type != None;
+	}
+
+	unsigned long errors = 0;  // Bytes that weren't part of a record
+
+private:
+	void number(std::string &text) {
+		uint32_t u = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+		char buffer[40];
+		if (type == Signed) { snprintf(buffer, sizeof(buffer), "%ld", (long) (int32_t) u); }
+		else if (type == Unsigned) { snprintf(buffer, sizeof(buffer), "%lu", (unsigned long) u); }
+		else { snprintf(buffer, sizeof(buffer), "\r\nLOG: Dropped %lu\r\n", (unsigned long) u); }
+		text += buffer;
+	}
+
+	static char hexDigit(uint8_t n) {
+		return n < 10 ? '0' + n : 'A' + (n - 10);
+	}
+
+	Type type = None;  // Record being decoded
+	uint8_t data[4];  // Number bytes so far
+	uint8_t length = 0;
+};
+
+}
+
+#endif
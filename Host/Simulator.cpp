@@ -0,0 +1,408 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Simulator.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <HID.h>
+#include <EEPROM.h>
+#include <avr/sleep.h>
+
+namespace Host {
+
+Simulator Sim;
+
+// --- Controller data ---
+
+// Writes 'width' bits of 'value' into a control data byte, with the top bit at 'start'
+static void setBits(uint8_t * data, uint8_t index, uint8_t start, uint8_t width, uint8_t value) {
+	uint8_t shift = start - width + 1;
+	uint8_t mask = ((1 << width) - 1) << shift;
+	data[index] = (data[index] & ~mask) | ((value << shift) & mask);
+}
+
+SimController::SimController() {
+	memset(data, 0xFF, sizeof(data));  // Unused bits are high, buttons are active low
+	memset(lastRead, 0xFF, sizeof(lastRead));
+	set("joyx", 32);
+	set("joyy", 32);
+	set("crossfade", 7);
+	set("fx", 0);
+	set("ltt", 0);
+	set("rtt", 0);
+	set("left", 0);  // Base only, until a trace attaches the turntables
+	set("right", 0);
+}
+
+bool SimController::set(const std::string &name, int value) {
+	struct Button {
+		const char * name;
+		uint8_t index;
+		uint8_t bit;
+	};
+
+	static const Button Buttons[] = {
+		{ "plus", 4, 2 }, { "minus", 4, 4 }, { "euphoria", 5, 4 },
+		{ "lgreen", 5, 3 }, { "lred", 4, 5 }, { "lblue", 5, 7 },
+		{ "rgreen", 5, 5 }, { "rred", 4, 1 }, { "rblue", 5, 2 },
+	};
+
+	for (const Button &b : Buttons) {
+		if (name == b.name) {
+			setBits(data, b.index, b.bit, 1, value ? 0 : 1);  // Active low
+			return true;
+		}
+	}
+
+	if (name == "joyx") { setBits(data, 0, 5, 6, value); }
+	else if (name == "joyy") { setBits(data, 1, 5, 6, value); }
+	else if (name == "crossfade") { setBits(data, 2, 4, 4, value); }
+	else if (name == "fx") {
+		setBits(data, 2, 6, 2, value >> 3);
+		setBits(data, 3, 7, 3, value);
+	}
+	else if (name == "ltt") {
+		setBits(data, 3, 4, 5, value & 0x1F);
+		setBits(data, 4, 0, 1, value < 0);
+	}
+	else if (name == "rtt") {
+		setBits(data, 2, 7, 1, value & 0x01);
+		setBits(data, 1, 7, 2, (value >> 1) & 0x03);
+		setBits(data, 0, 7, 2, (value >> 3) & 0x03);
+		setBits(data, 2, 0, 1, value < 0);
+	}
+	else if (name == "left") { setBits(data, 5, 0, 1, value != 0); }  // Left table attached
+	else if (name == "right") { setBits(data, 5, 1, 1, value != 0); }  // Right table attached
+	else { return false; }
+
+	return true;
+}
+
+// --- Simulator ---
+
+Simulator::Simulator() {
+	memset(eeprom, 0xFF, sizeof(eeprom));  // Erased
+	memset(pinInputs, Floating, sizeof(pinInputs));
+}
+
+void Simulator::advance(unsigned long us) {
+	now += us;
+}
+
+void Simulator::sleep() {
+	unsigned long wake = (now / 1000 + 1) * 1000;
+	sleptTime += wake - now;
+	now = wake;
+	sleeps++;
+}
+
+int Simulator::readPin(uint8_t pin) const {
+	if (pinModes[pin] == OUTPUT) { return pinOutputs[pin]; }
+	if (pinInputs[pin] == Floating) { return pinModes[pin] == INPUT_PULLUP ? HIGH : LOW; }
+	return pinInputs[pin];
+}
+
+void Simulator::plug(uint8_t channel, bool state) {
+	SimController &c = controllers[channel];
+	c.plugged = state;
+	pinInputs[c.detectPin] = state ? HIGH : LOW;
+}
+
+SimController * Simulator::selectedController() {
+	if (muxChannels == 0) {
+		return controllers[0].plugged ? &controllers[0] : nullptr;
+	}
+
+	for (uint8_t i = 0; i < muxChannels; i++) {
+		if ((muxMask & (1 << i)) && controllers[i].plugged) {
+			return &controllers[i];
+		}
+	}
+	return nullptr;
+}
+
+uint8_t Simulator::busWrite(uint8_t address, const uint8_t * data, uint8_t length) {
+	unsigned long t = (1 + length) * 9 * 1000000UL / busClock;  // 9 clocks per byte
+	advance(t);
+	busTime += t;
+	busWrites++;
+
+	if (busStuck) { return 4; }  // Other error
+
+	if (muxChannels != 0 && address == MuxAddress) {
+		if (muxFailures != 0) {
+			muxFailures--;
+			return 2;  // NACK on address
+		}
+		if (length > 0) { muxMask = data[length - 1]; }
+		return 0;
+	}
+
+	if (address == ControllerAddress && selectedController() != nullptr) {
+		return 0;
+	}
+
+	return 2;  // Nobody home
+}
+
+uint8_t Simulator::busRead(uint8_t address, uint8_t * data, uint8_t length) {
+	unsigned long t = (1 + length) * 9 * 1000000UL / busClock;
+	advance(t);
+	busTime += t;
+
+	if (busStuck || address != ControllerAddress) { return 0; }
+
+	SimController * c = selectedController();
+	if (c == nullptr) { return 0; }
+
+	if (c->failReads != 0) {
+		c->failReads--;
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < length; i++) {
+		data[i] = i < sizeof(c->data) ? c->data[i] : 0xFF;
+	}
+	c->reads++;
+
+	if (memcmp(c->lastRead, c->data, sizeof(c->data)) != 0) {
+		memcpy(c->lastRead, c->data, sizeof(c->data));
+		inputRead();
+	}
+	return length;
+}
+
+void Simulator::inputRead() {
+	inputTime = now;  // Newer data restarts the timer
+	inputPending = true;
+}
+
+void Simulator::receiveReport(uint8_t id, const uint8_t * data, int length) {
+	if (inputPending) {
+		unsigned long latency = now - inputTime;
+		if (latencySamples == 0 || latency < latencyMin) { latencyMin = latency; }
+		if (latency > latencyMax) { latencyMax = latency; }
+		latencyTotal += latency;
+		latencySamples++;
+		inputPending = false;
+	}
+
+	if (echoReports) {
+		printf("[%8.3f ms] report %u:", now / 1000.0, id);
+		for (int i = 0; i < length; i++) { printf(" %02X", data[i]); }
+		printf("\n");
+	}
+
+	if (id == 1 && length == 5) {  // Mouse: buttons, 16-bit X / Y
+		mouseButtons = data[0];
+		mouseX += (int16_t) (data[1] | (data[2] << 8));
+		mouseY += (int16_t) (data[3] | (data[4] << 8));
+		mouseReports++;
+	}
+	else if (id == 2 && length == 14) {  // Keyboard: modifiers, key bitmap
+		modifiers = data[0];
+		memset(keys, 0, sizeof(keys));
+		memcpy(keys, data + 1, 13);
+		keyboardReports++;
+	}
+	else if (id == 3 && length == 8) {  // Gamepad: 16 buttons, 6 axes
+		padButtons = data[0] | (data[1] << 8);
+		memcpy(padAxes, data + 2, sizeof(padAxes));
+		padReports++;
+	}
+	else {
+		printf("Unknown report: ID %u, %d bytes\n", id, length);
+	}
+}
+
+void Simulator::serialWrite(uint8_t c) {
+	serialRaw += (char) c;
+
+	std::string text(1, (char) c);
+	if (binaryLog) {
+		text.clear();
+		log.feed(c, text);
+	}
+
+	serialOut += text;
+	if (echoSerial) { fputs(text.c_str(), stdout); }
+}
+
+void Simulator::clearCounters() {
+	mouseX = mouseY = 0;
+	keyboardReports = mouseReports = padReports = 0;
+	busTime = 0;
+	busWrites = 0;
+	sleeps = 0;
+	sleptTime = 0;
+	countStart = now;
+	loops = 0;
+	latencyMin = latencyMax = latencyTotal = latencySamples = 0;
+	serialOut.clear();
+	for (SimController &c : controllers) { c.reads = 0; }
+}
+
+}  // namespace Host
+
+using Host::Sim;
+namespace Cost = Host::Cost;
+
+// --- Arduino core ---
+
+HostSerial Serial;
+TwoWire Wire;
+EEPROMClass EEPROM;
+
+volatile uint16_t TCNT1;
+volatile uint8_t TCCR1A, TCCR1B;
+
+extern "C" char __heap_start;
+extern "C" char * __brkval;
+char __heap_start;
+char * __brkval = nullptr;
+
+unsigned long millis() {
+	Sim.advance(Cost::Millis);
+	return Sim.now / 1000;
+}
+
+unsigned long micros() {
+	Sim.advance(Cost::Micros);
+	return Sim.now;
+}
+
+void delay(unsigned long ms) { Sim.advance(ms * 1000); }
+void delayMicroseconds(unsigned int us) { Sim.advance(us); }
+
+uint16_t hostUSBFrame() { return (Sim.now / 1000) & 0x7FF; }  // 11-bit frame number, 1 ms frames
+
+void sleep_mode() { Sim.sleep(); }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	Sim.advance(Cost::PinMode);
+	Sim.pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	Sim.advance(Cost::DigitalWrite);
+	if (pin == Sim.sclPin && Sim.pinModes[pin] == OUTPUT && value == LOW && Sim.busStuck) {
+		if (++Sim.sclPulses >= 3) {  // Stuck device finishes its byte and lets go
+			Sim.busStuck = false;
+			Sim.sclPulses = 0;
+		}
+	}
+	Sim.pinOutputs[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+	Sim.advance(Cost::DigitalRead);
+	if (pin == Sim.sdaPin && Sim.busStuck) { return LOW; }
+	return Sim.readPin(pin);
+}
+
+char * ltoa(long value, char * buffer, int) {
+	sprintf(buffer, "%ld", value);
+	return buffer;
+}
+
+char * ultoa(unsigned long value, char * buffer, int) {
+	sprintf(buffer, "%lu", value);
+	return buffer;
+}
+
+boolean HostSerial::dtr() const { return Sim.serialOpen; }
+int HostSerial::availableForWrite() const { return 64; }  // The host keeps up
+
+size_t HostSerial::write(uint8_t c) {
+	Sim.advance(Cost::SerialWrite);
+	Sim.serialWrite(c);
+	return 1;
+}
+
+int HostSerial::available() { return Sim.serialIn.size(); }
+
+int HostSerial::read() {
+	if (Sim.serialIn.empty()) { return -1; }
+	int c = (uint8_t) Sim.serialIn[0];
+	Sim.serialIn.erase(0, 1);
+	return c;
+}
+
+// --- Wire ---
+
+void TwoWire::begin() {}
+void TwoWire::end() {}
+void TwoWire::setClock(uint32_t clock) { Sim.busClock = clock; }
+
+void TwoWire::beginTransmission(uint8_t addr) {
+	address = addr;
+	txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+	if (txLength >= sizeof(txBuffer)) { return 0; }
+	txBuffer[txLength++] = data;
+	return 1;
+}
+
+uint8_t TwoWire::endTransmission(boolean) {
+	return Sim.busWrite(address, txBuffer, txLength);
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t quantity) {
+	if (quantity > sizeof(rxBuffer)) { quantity = sizeof(rxBuffer); }
+	rxLength = Sim.busRead(addr, rxBuffer, quantity);
+	rxIndex = 0;
+	return rxLength;
+}
+
+int TwoWire::available() { return rxLength - rxIndex; }
+int TwoWire::read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+
+// --- HID ---
+
+static HID_ HIDInterface;
+HID_ & HID() { return HIDInterface; }
+
+int HID_::SendReport(uint8_t id, const void * data, int len) {
+	Sim.advance(Cost::HIDReport);
+	Sim.receiveReport(id, (const uint8_t *) data, len);
+	return len;
+}
+
+void HID_::AppendDescriptor(HIDSubDescriptor *) {}
+
+// --- EEPROM ---
+
+uint8_t EEPROMClass::read(int address) {
+	Sim.advance(Cost::EEPROMRead);
+	return Sim.eeprom[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+	Sim.advance(Cost::EEPROMWrite);
+	Sim.eeprom[address] = value;
+	Sim.eepromWrites++;
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+	if (Sim.eeprom[address] != value) { write(address, value); }
+}
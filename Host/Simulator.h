@@ -0,0 +1,152 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef Host_Simulator_h
+#define Host_Simulator_h
+
+#include <stdint.h>
+#include <string>
+
+#include "LogDecoder.h"
+
+namespace Host {
+
+// CPU time charged for each call into the Arduino core, roughly a 16 MHz 32U4 (us).
+// Bus transfers are charged by the simulated bus, at the bus clock.
+namespace Cost {
+	const unsigned long Loop = 2;  // Calling loop(), and the sketch's own work between core calls
+	const unsigned long Millis = 1;
+	const unsigned long Micros = 2;
+	const unsigned long PinMode = 3;
+	const unsigned long DigitalRead = 4;
+	const unsigned long DigitalWrite = 5;
+	const unsigned long SerialWrite = 2;  // Per byte, into the USB buffer
+	const unsigned long HIDReport = 40;  // Filling and releasing the USB endpoint
+	const unsigned long EEPROMRead = 1;
+	const unsigned long EEPROMWrite = 3400;  // Erase and write, blocking
+}
+
+// SimController: One DJ Hero controller on the simulated bus. The control data is
+//                kept as the raw 6 bytes, the same as a capture.
+struct SimController {
+	SimController();
+
+	// Sets a control by name (see Simulator.cpp), returns 'false' if there's no such control
+	bool set(const std::string &name, int value);
+
+	bool plugged = false;  // Attached and powered, answers on the bus
+	uint8_t detectPin = 0;  // Pin that goes high while plugged in
+	uint8_t data[6];  // Raw control data
+	unsigned int failReads = 0;  // Number of upcoming reads that fail
+	unsigned long reads = 0;  // Number of successful reads
+	uint8_t lastRead[6];  // Data from the last successful read
+};
+
+// Simulator: The board and everything attached to it. A virtual clock, the pins,
+//            the I2C bus with an optional TCA9548A multiplexer and up to 8
+//            controllers, the EEPROM, the serial port, and the USB host that
+//            receives the HID reports.
+class Simulator {
+public:
+	Simulator();
+
+	// --- Clock ---
+	void advance(unsigned long us);  // Moves the clock forward
+	void sleep();  // Idles until the next interrupt (the next 1 ms tick / USB frame)
+
+	unsigned long now = 0;  // Time since boot (us)
+	unsigned long sleeps = 0;  // Number of times the CPU idled
+	unsigned long sleptTime = 0;  // Time spent idle (us)
+	unsigned long countStart = 0;  // Time the counters were last cleared (us)
+	unsigned long loops = 0;  // Number of passes through loop()
+
+	// --- Pins ---
+	static const int8_t Floating = -1;
+
+	uint8_t pinModes[64] = {};
+	uint8_t pinOutputs[64] = {};  // Level written to each pin
+	int8_t pinInputs[64];  // Level driven onto each pin from outside, or 'Floating'
+	int readPin(uint8_t pin) const;  // Floating inputs read high with the pull-up, low without
+
+	uint8_t sdaPin = 2;  // I2C pins, Leonardo
+	uint8_t sclPin = 3;
+
+	// --- I2C bus ---
+	static const uint8_t MaxChannels = 8;
+	static const uint8_t MuxAddress = 0x70;
+	static const uint8_t ControllerAddress = 0x52;
+
+	void plug(uint8_t channel, bool state);
+
+	uint8_t muxChannels = 0;  // Channels on the multiplexer, 0 for no multiplexer
+	uint8_t muxMask = 0;  // Control register of the multiplexer
+	unsigned int muxFailures = 0;  // Number of upcoming multiplexer writes that fail
+	SimController controllers[MaxChannels];
+
+	bool busStuck = false;  // A device is holding SDA low
+	uint8_t sclPulses = 0;  // SCL clocks while the bus is stuck
+	uint32_t busClock = 100000;  // Hz
+	unsigned long busTime = 0;  // Time spent on bus transfers (us)
+	unsigned long busWrites = 0;  // Write transfers, to any address
+
+	SimController * selectedController();  // Controller answering at 0x52, if any
+	uint8_t busWrite(uint8_t address, const uint8_t * data, uint8_t length);  // Returns the Wire status code
+	uint8_t busRead(uint8_t address, uint8_t * data, uint8_t length);  // Returns the number of bytes read
+
+	// --- EEPROM ---
+	uint8_t eeprom[1024];
+	unsigned long eepromWrites = 0;
+
+	// --- Serial ---
+	void serialWrite(uint8_t c);
+
+	std::string serialRaw;  // Everything written by the sketch since boot
+	std::string serialOut;  // Output since the counters were cleared, decoded if it's a debug log
+	std::string serialIn;  // Waiting to be read by the sketch
+	bool serialOpen = true;  // DTR, whether a terminal is connected
+	bool echoSerial = false;  // Print the sketch's serial output as it's written
+	bool binaryLog = false;  // Whether the output is a binary debug log (DEBUG builds)
+	LogDecoder log;
+
+	// --- USB host ---
+	void receiveReport(uint8_t id, const uint8_t * data, int length);
+	void clearCounters();
+
+	uint8_t keys[32] = {};  // Keyboard state, one bit per usage
+	uint8_t modifiers = 0;
+	uint8_t mouseButtons = 0;
+	long mouseX = 0, mouseY = 0;  // Motion since the counters were cleared
+	uint16_t padButtons = 0;
+	int8_t padAxes[6] = {};
+	unsigned long keyboardReports = 0, mouseReports = 0, padReports = 0;
+	bool echoReports = false;  // Print each report as it's received
+
+	// Latency from a read with new data to the next report
+	void inputRead();  // Call when a read returns new data
+	unsigned long inputTime = 0;  // Timestamp for the latest new data (us)
+	bool inputPending = false;  // Whether the latest new data hasn't been followed by a report yet
+	unsigned long latencyMin = 0, latencyMax = 0, latencyTotal = 0, latencySamples = 0;  // (us)
+};
+
+extern Simulator Sim;
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Builds the sketch for the host, the same way the Arduino IDE does: the .ino file
+// with prototypes for its functions added at the top. Include it in one file per
+// program, the sketch's globals are defined here.
+
+#ifndef Host_Sketch_h
+#define Host_Sketch_h
+
+#include <Arduino.h>
+
+void djController();
+void gamepad();
+void betweenPolls();
+void aiming(int8_t xIn, int8_t yIn);
+void memoryReport();
+
+#include "../Arduino/DJLucio/DJLucio.ino"
+
+#endif
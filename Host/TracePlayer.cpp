@@ -0,0 +1,317 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Runs the sketch against a trace: a script of controller inputs at given times,
+// and the HID output expected from them. See README.md for the trace format.
+
+#include <fstream>
+#include <sstream>
+
+#include "Simulator.h"
+#include "Sketch.h"
+
+using Host::Sim;
+
+static std::string traceName;
+static unsigned int lineNumber = 0;
+static unsigned int failures = 0;
+static bool booted = false;
+static uint8_t channel = 0;  // Controller that commands apply to
+
+static void fail(const std::string &message) {
+	printf("%s:%u: [%.3f ms] %s\n", traceName.c_str(), lineNumber, Sim.now / 1000.0, message.c_str());
+	failures++;
+}
+
+static void boot() {
+	if (booted) { return; }
+	booted = true;
+	setup();
+}
+
+// Runs the sketch until the given time (ms since boot)
+static void runUntil(unsigned long ms) {
+	boot();
+	while (Sim.now < ms * 1000) {
+		loop();  // Calls into the core and the bus move the clock by the work done
+		Sim.advance(Host::Cost::Loop);
+		Sim.loops++;
+	}
+}
+
+static bool compare(long actual, const std::string &op, long expected) {
+	if (op == "==") { return actual == expected; }
+	if (op == "!=") { return actual != expected; }
+	if (op == "<") { return actual < expected; }
+	if (op == "<=") { return actual <= expected; }
+	if (op == ">") { return actual > expected; }
+	if (op == ">=") { return actual >= expected; }
+	fail("Unknown comparison '" + op + "'");
+	return false;
+}
+
+// Keyboard usage for a key name, 0 if unknown
+static uint8_t keyUsage(const std::string &name) {
+	if (name.size() == 1) {
+		char c = name[0];
+		if (c >= 'a' && c <= 'z') { return 0x04 + (c - 'a'); }
+		if (c >= '1' && c <= '9') { return 0x1E + (c - '1'); }
+		if (c == '0') { return 0x27; }
+	}
+	if (name == "space") { return 0x2C; }
+	if (name == "enter") { return 0x28; }
+	if (name == "tab") { return 0x2B; }
+	return 0;
+}
+
+// Modifier bit for a key name, 0 if it isn't a modifier
+static uint8_t keyModifier(const std::string &name) {
+	if (name == "ctrl") { return 0x01; }
+	if (name == "shift") { return 0x02; }
+	if (name == "alt") { return 0x04; }
+	if (name == "gui") { return 0x08; }
+	return 0;
+}
+
+static void expect(std::istringstream &args) {
+	std::string what;
+	args >> what;
+
+	std::string a, b, c;
+	args >> a >> b;
+	std::getline(args >> std::ws, c);
+
+	long actual = 0;
+	std::string op = "==";
+	long expected = 0;
+
+	if (what == "key") {
+		uint8_t modifier = keyModifier(a);
+		uint8_t usage = keyUsage(a);
+		if (modifier != 0) { actual = (Sim.modifiers & modifier) != 0; }
+		else if (usage != 0) { actual = (Sim.keys[usage / 8] >> (usage % 8)) & 1; }
+		else { return fail("Unknown key '" + a + "'"); }
+		expected = atol(b.c_str());
+	}
+	else if (what == "click") {
+		uint8_t button = a == "left" ? 1 : a == "right" ? 2 : a == "middle" ? 4 : 0;
+		if (button == 0) { return fail("Unknown mouse button '" + a + "'"); }
+		actual = (Sim.mouseButtons & button) != 0;
+		expected = atol(b.c_str());
+	}
+	else if (what == "mouse") {
+		actual = a == "x" ? Sim.mouseX : Sim.mouseY;
+		op = b;
+		expected = atol(c.c_str());
+	}
+	else if (what == "pad") {
+		static const char * const Axes[] = { "x", "y", "z", "rx", "ry", "rz" };
+		if (a == "button") {
+			int index = atoi(b.c_str());
+			std::istringstream rest(c);
+			rest >> expected;
+			actual = (Sim.padButtons >> index) & 1;
+		}
+		else {
+			int axis = -1;
+			for (int i = 0; i < 6; i++) {
+				if (a == Axes[i]) { axis = i; }
+			}
+			if (axis < 0) { return fail("Unknown gamepad axis '" + a + "'"); }
+			actual = Sim.padAxes[axis];
+			op = b;
+			expected = atol(c.c_str());
+		}
+	}
+	else if (what == "reads") {
+		actual = Sim.controllers[channel].reads;
+		op = a;
+		a.clear();
+		expected = atol(b.c_str());
+	}
+	else if (what == "writes") {
+		actual = Sim.busWrites;
+		op = a;
+		a.clear();
+		expected = atol(b.c_str());
+	}
+	else if (what == "reports") {
+		actual = a == "keyboard" ? Sim.keyboardReports : a == "mouse" ? Sim.mouseReports : Sim.padReports;
+		op = b;
+		expected = atol(c.c_str());
+	}
+	else if (what == "idle") {  // Percent of the time spent asleep
+		unsigned long total = Sim.now - Sim.countStart;
+		actual = total == 0 ? 0 : (Sim.sleptTime * 100) / total;
+		op = a;
+		a.clear();
+		expected = atol(b.c_str());
+	}
+	else if (what == "led") {
+		actual = Sim.pinOutputs[LED_Pin] ^ LED_Inverted;
+		expected = atol(a.c_str());
+		a.clear();
+	}
+	else if (what == "connected") {
+		actual = controller.isOnline();
+		expected = atol(a.c_str());
+		a.clear();
+	}
+	else if (what == "serial" || what == "noserial") {
+		std::string text = a + (b.empty() ? "" : " " + b) + (c.empty() ? "" : " " + c);
+		bool found = Sim.serialOut.find(text) != std::string::npos;
+		if (found != (what == "serial")) {
+			fail("Expected serial output " + std::string(found ? "without" : "with") + " '" + text + "'");
+		}
+		return;
+	}
+	else {
+		return fail("Unknown expectation '" + what + "'");
+	}
+
+	if (!compare(actual, op, expected)) {
+		std::ostringstream message;
+		message << "Expected " << what << (a.empty() ? "" : " " + a) << " " << op << " " << expected << ", got " << actual;
+		fail(message.str());
+	}
+}
+
+static void command(std::istringstream &line) {
+	std::string cmd;
+	if (!(line >> cmd)) { return; }
+
+	if (cmd[0] == '@') {
+		runUntil(strtoul(cmd.c_str() + 1, nullptr, 10));
+		return command(line);  // Rest of the line runs at this time
+	}
+
+	Host::SimController &con = Sim.controllers[channel];
+
+	if (cmd == "channel") {
+		int n;
+		line >> n;
+		channel = n;
+	}
+	else if (cmd == "mux") {
+		int n;
+		line >> n;
+		Sim.muxChannels = n;
+	}
+	else if (cmd == "detect") {
+		int pin;
+		line >> pin;
+		con.detectPin = pin;
+	}
+	else if (cmd == "plug") { Sim.plug(channel, true); }
+	else if (cmd == "unplug") { Sim.plug(channel, false); }
+	else if (cmd == "set") {
+		std::string name;
+		int value;
+		line >> name >> value;
+		if (!con.set(name, value)) { fail("Unknown control '" + name + "'"); }
+	}
+	else if (cmd == "raw") {
+		for (uint8_t &byte : con.data) {
+			unsigned int value;
+			line >> std::hex >> value >> std::dec;
+			byte = value;
+		}
+	}
+	else if (cmd == "fail") { line >> con.failReads; }
+	else if (cmd == "muxfail") { line >> Sim.muxFailures; }
+	else if (cmd == "stuck") { Sim.busStuck = true; }
+	else if (cmd == "serial") {
+		std::string text;
+		std::getline(line >> std::ws, text);
+		Sim.serialIn += text;
+	}
+	else if (cmd == "clear") { Sim.clearCounters(); }
+	else if (cmd == "expect") { expect(line); }
+	else { fail("Unknown command '" + cmd + "'"); }
+}
+
+// Rates and latency since the counters were last cleared
+static void printStats() {
+	double seconds = (Sim.now - Sim.countStart) / 1000000.0;
+	if (seconds <= 0) { return; }
+
+	printf("  loops/s %.0f | reports/s keyboard %.1f mouse %.1f pad %.1f | latency (us) ",
+		Sim.loops / seconds, Sim.keyboardReports / seconds, Sim.mouseReports / seconds, Sim.padReports / seconds);
+	if (Sim.latencySamples == 0) {
+		printf("none\n");
+	}
+	else {
+		printf("min %lu mean %lu max %lu (%lu samples)\n",
+			Sim.latencyMin, Sim.latencyTotal / Sim.latencySamples, Sim.latencyMax, Sim.latencySamples);
+	}
+}
+
+static void usage() {
+	printf("Usage: djlucio-sim [-s] [-r] [-o serial.bin] trace\n");
+	printf("  -s  print the sketch's serial output\n");
+	printf("  -r  print the HID reports\n");
+	printf("  -o  save the raw serial output to a file (e.g. a DEBUG_CAPTURE stream or a debug log)\n");
+}
+
+int main(int argc, char * argv[]) {
+	const char * serialFile = nullptr;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		std::string opt = argv[i];
+		if (opt == "-s") { Sim.echoSerial = true; }
+		else if (opt == "-r") { Sim.echoReports = true; }
+		else if (opt == "-o" && i + 1 < argc) { serialFile = argv[++i]; }
+		else { usage(); return 2; }
+	}
+	if (i != argc - 1) { usage(); return 2; }
+
+	traceName = argv[i];
+	std::ifstream trace(traceName);
+	if (!trace) {
+		printf("Can't open '%s'\n", traceName.c_str());
+		return 2;
+	}
+
+	#ifdef DEBUG
+	Sim.binaryLog = true;  // Decode the debug log for 'expect serial' and '-s'
+	#endif
+
+	Sim.controllers[0].detectPin = DetectPin;
+	Sim.pinInputs[DetectPin] = LOW;  // Pulled down, nothing plugged in
+
+	std::string text;
+	while (std::getline(trace, text)) {
+		lineNumber++;
+		text = text.substr(0, text.find('#'));  // Strip comments
+		std::istringstream line(text);
+		command(line);
+	}
+	boot();  // Even an empty trace should start
+
+	if (serialFile != nullptr) {
+		std::ofstream out(serialFile, std::ios::binary);
+		out << Sim.serialRaw;
+	}
+
+	printf("%s: %s (%.0f ms)\n", traceName.c_str(), failures == 0 ? "PASS" : "FAIL", Sim.now / 1000.0);
+	printStats();
+	return failures == 0 ? 0 : 1;
+}
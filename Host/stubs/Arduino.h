@@ -0,0 +1,118 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stand-in for the Arduino core, just enough of it to build the sketch.
+// Time, pins, and the serial port are all run by the simulator (Simulator.h).
+
+#ifndef Host_Arduino_h
+#define Host_Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define LED_BUILTIN 13
+#define SDA 2
+#define SCL 3
+
+#define E2END 1023  // ATmega32U4, 1 KB
+
+#define F_CPU 16000000UL
+
+#define PROGMEM
+#define F(x) (x)
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(const uint16_t *) (p))
+
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+char * ltoa(long value, char * buffer, int radix);
+char * ultoa(unsigned long value, char * buffer, int radix);
+
+// USB frame number registers
+uint16_t hostUSBFrame();
+#define UDFNUML ((uint8_t) hostUSBFrame())
+#define UDFNUMH ((uint8_t) (hostUSBFrame() >> 8))
+
+// Timer 1, for the profiler's cycle counter
+extern volatile uint16_t TCNT1;
+extern volatile uint8_t TCCR1A, TCCR1B;
+#define CS11 1
+
+class Print {
+public:
+	virtual size_t write(uint8_t c) = 0;
+
+	size_t write(const uint8_t * buffer, size_t size) {
+		size_t n = 0;
+		while (size--) { n += write(*buffer++); }
+		return n;
+	}
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	using Print::write;
+};
+
+// Serial: USB CDC port, with output and input held by the simulator
+class HostSerial : public Stream {
+public:
+	void begin(unsigned long) {}
+	operator bool() const { return true; }
+	boolean dtr() const;
+	int availableForWrite() const;
+
+	size_t write(uint8_t c) override;
+	using Stream::write;
+
+	int available() override;
+	int read() override;
+};
+
+extern HostSerial Serial;
+
+#endif
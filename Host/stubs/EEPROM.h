@@ -0,0 +1,50 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stand-in for the EEPROM library, backed by the simulator's memory
+
+#ifndef Host_EEPROM_h
+#define Host_EEPROM_h
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+	void update(int address, uint8_t value);
+	uint16_t length() { return E2END + 1; }
+
+	template<class T> T & get(int address, T &t) {
+		uint8_t * p = (uint8_t *) &t;
+		for (size_t i = 0; i < sizeof(T); i++) { p[i] = read(address + i); }
+		return t;
+	}
+
+	template<class T> const T & put(int address, const T &t) {
+		const uint8_t * p = (const uint8_t *) &t;
+		for (size_t i = 0; i < sizeof(T); i++) { update(address + i, p[i]); }
+		return t;
+	}
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,44 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stand-in for the PluggableUSB HID library. Reports go to the simulated host.
+
+#ifndef Host_HID_h
+#define Host_HID_h
+
+#include "Arduino.h"
+
+class HIDSubDescriptor {
+public:
+	HIDSubDescriptor(const void * d, uint16_t l) : data(d), length(l) {}
+
+	const void * data;
+	const uint16_t length;
+};
+
+class HID_ {
+public:
+	int SendReport(uint8_t id, const void * data, int len);
+	void AppendDescriptor(HIDSubDescriptor * node);
+};
+
+HID_ & HID();
+
+#endif
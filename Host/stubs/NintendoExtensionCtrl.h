@@ -0,0 +1,186 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stand-in for the NintendoExtensionCtrl library (0.7.4), with just the parts
+// the sketch uses. Connecting and updating go over the simulated bus like the real
+// library, and the DJ controller decodes the same 6 bytes of control data.
+//
+// The library can tell which turntables are attached from the data. The simulated
+// controller marks them with otherwise unused bits: byte 5 bit 0 for the left table
+// and byte 5 bit 1 for the right, set when attached.
+
+#ifndef Host_NintendoExtensionCtrl_h
+#define Host_NintendoExtensionCtrl_h
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define NXC_I2C_TYPE    TwoWire
+#define NXC_I2C_DEFAULT Wire
+
+struct ExtensionData {
+	ExtensionData(NXC_I2C_TYPE &i2cBus = NXC_I2C_DEFAULT) : i2c(i2cBus) {}
+
+	NXC_I2C_TYPE & i2c;
+	uint8_t controlData[21] = {};
+};
+
+class ExtensionController {
+public:
+	ExtensionController(ExtensionData &dataRef) : data(dataRef) {}
+
+	void begin() {
+		data.i2c.begin();
+	}
+
+	boolean connect() {
+		// Unencrypted init, then the first read
+		return writeRegister(0xF0, 0x55) && writeRegister(0xFB, 0x00) && update();
+	}
+
+	boolean update() {
+		if (!writeRegister(0x00)) { return false; }
+		delayMicroseconds(175);  // Conversion time
+		if (data.i2c.requestFrom(I2C_Addr, (uint8_t) 6) != 6) { return false; }
+		for (uint8_t i = 0; i < 6; i++) {
+			data.controlData[i] = data.i2c.read();
+		}
+		return true;
+	}
+
+	uint8_t getControlData(uint8_t index) const {
+		return data.controlData[index];
+	}
+
+	static const uint8_t I2C_Addr = 0x52;
+
+protected:
+	boolean writeRegister(uint8_t reg) {
+		data.i2c.beginTransmission(I2C_Addr);
+		data.i2c.write(reg);
+		return data.i2c.endTransmission() == 0;
+	}
+
+	boolean writeRegister(uint8_t reg, uint8_t value) {
+		data.i2c.beginTransmission(I2C_Addr);
+		data.i2c.write(reg);
+		data.i2c.write(value);
+		return data.i2c.endTransmission() == 0;
+	}
+
+	// Bits from 'start' to 'end' (inclusive, high to low) of a control data byte
+	uint8_t bits(uint8_t index, uint8_t start, uint8_t end) const {
+		return (data.controlData[index] >> end) & ((1 << (start - end + 1)) - 1);
+	}
+
+	boolean bit(uint8_t index, uint8_t pos) const {
+		return data.controlData[index] & (1 << pos);
+	}
+
+	ExtensionData & data;
+};
+
+class DJTurntableController : public ExtensionController {
+public:
+	enum class TurntableConfig : uint8_t { BaseOnly, Left, Right, Both };
+
+	class TurntableExpansion {
+	public:
+		TurntableExpansion(DJTurntableController &b, boolean isLeft) : base(b), Left(isLeft) {}
+
+		int8_t turntable() const {
+			uint8_t magnitude;
+			boolean negative;
+			if (Left) {
+				magnitude = base.bits(3, 4, 0);
+				negative = base.bit(4, 0);
+			}
+			else {
+				magnitude = (base.bits(0, 7, 6) << 3) | (base.bits(1, 7, 6) << 1) | base.bits(2, 7, 7);
+				negative = base.bit(2, 0);
+			}
+			return negative ? (int8_t) magnitude - 32 : (int8_t) magnitude;
+		}
+
+		boolean buttonGreen() const { return connected() && !(Left ? base.bit(5, 3) : base.bit(5, 5)); }
+		boolean buttonRed() const { return connected() && !(Left ? base.bit(4, 5) : base.bit(4, 1)); }
+		boolean buttonBlue() const { return connected() && !(Left ? base.bit(5, 7) : base.bit(5, 2)); }
+
+		boolean connected() const {
+			return base.bit(5, Left ? 0 : 1);
+		}
+
+	private:
+		DJTurntableController & base;
+		const boolean Left;
+	};
+
+	class EffectRollover {
+	public:
+		EffectRollover(DJTurntableController &controller) : dj(controller) {}
+
+		int8_t getChange() {
+			uint8_t current = dj.effectDial();
+			int8_t change = (int8_t) ((current - last) & 0x1F);
+			if (change > 15) { change -= 32; }  // Shortest way around the dial
+			last = current;
+			return change;
+		}
+
+	private:
+		DJTurntableController & dj;
+		uint8_t last = 0;
+	};
+
+	DJTurntableController(ExtensionData &dataRef) : ExtensionController(dataRef), left(*this, true), right(*this, false) {}
+
+	int8_t turntable() const {
+		return (left.connected() ? left.turntable() : 0) + (right.connected() ? right.turntable() : 0);
+	}
+
+	uint8_t effectDial() const { return (bits(2, 6, 5) << 3) | bits(3, 7, 5); }
+	uint8_t crossfadeSlider() const { return bits(2, 4, 1); }
+	uint8_t joyX() const { return bits(0, 5, 0); }
+	uint8_t joyY() const { return bits(1, 5, 0); }
+
+	boolean buttonGreen() const { return left.buttonGreen() || right.buttonGreen(); }
+	boolean buttonRed() const { return left.buttonRed() || right.buttonRed(); }
+	boolean buttonBlue() const { return left.buttonBlue() || right.buttonBlue(); }
+
+	boolean buttonPlus() const { return !bit(4, 2); }
+	boolean buttonMinus() const { return !bit(4, 4); }
+	boolean buttonEuphoria() const { return !bit(5, 4); }
+
+	TurntableConfig getTurntableConfig() const {
+		if (left.connected() && right.connected()) { return TurntableConfig::Both; }
+		if (left.connected()) { return TurntableConfig::Left; }
+		if (right.connected()) { return TurntableConfig::Right; }
+		return TurntableConfig::BaseOnly;
+	}
+
+	uint8_t getNumTurntables() const {
+		return left.connected() + right.connected();
+	}
+
+	TurntableExpansion left;
+	TurntableExpansion right;
+};
+
+#endif
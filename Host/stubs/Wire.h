@@ -0,0 +1,55 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stand-in for the Wire library. Transfers go to the simulated bus.
+
+#ifndef Host_Wire_h
+#define Host_Wire_h
+
+#include "Arduino.h"
+
+class TwoWire : public Stream {
+public:
+	void begin();
+	void end();
+	void setClock(uint32_t clock);
+
+	void beginTransmission(uint8_t address);
+	uint8_t endTransmission(boolean stop = true);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity);
+
+	size_t write(uint8_t data) override;
+	using Stream::write;
+
+	int available() override;
+	int read() override;
+
+private:
+	uint8_t address = 0;
+	uint8_t txBuffer[32];
+	uint8_t txLength = 0;
+	uint8_t rxBuffer[32];
+	uint8_t rxLength = 0;
+	uint8_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
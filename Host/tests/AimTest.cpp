@@ -0,0 +1,95 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Aim scaling: fractional counts carried between polls, and the acceleration curve
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Platforms.h"
+#include "DJLucio_Aim.h"
+
+typedef AccelerationCurve<0, 4> Flat;
+typedef AccelerationCurve<50, 4> Accelerated;  // +50% per count above 4
+typedef AccelerationCurve<255, 0> Steepest;  // Hits the max gain right away
+
+static_assert(AimAxis<Flat>::validSensitivity(127.0), "Full 8.8 range without acceleration");
+static_assert(!AimAxis<Flat>::validSensitivity(128.0), "Past the 8.8 range");
+static_assert(!AimAxis<Flat>::validSensitivity(-128.5), "Past the 8.8 range");
+static_assert(AimAxis<Steepest>::validSensitivity(31.0), "Max gain, any int8_t input");
+static_assert(!AimAxis<Steepest>::validSensitivity(32.0), "Overflows 32 bits at the max gain");
+
+// Total output for 'polls' polls of the same input
+template<class Curve>
+static long total(AimAxis<Curve> &axis, int8_t input, unsigned int polls) {
+	long sum = 0;
+	for (unsigned int i = 0; i < polls; i++) {
+		sum += axis.scale(input);
+	}
+	return sum;
+}
+
+int main() {
+	// Slow input below a whole count per poll still adds up
+	AimAxis<Flat> quarter(0.25);
+	CHECK(quarter.scale(1) == 0);
+	CHECK(quarter.scale(1) == 0);
+	CHECK(quarter.scale(1) == 0);
+	CHECK(quarter.scale(1) == 1);
+	CHECK(total(quarter, 1, 400) == 100);
+
+	AimAxis<Flat> reverse(0.25);
+	CHECK(total(reverse, -1, 400) == -100);
+
+	// Fractional sensitivity on every poll
+	AimAxis<Flat> oneHalf(1.5);
+	CHECK(oneHalf.scale(1) + oneHalf.scale(1) == 3);
+	CHECK(total(oneHalf, 3, 100) == 450);
+	CHECK(total(oneHalf, -3, 100) == -450);
+
+	// Changing direction doesn't lose or add counts
+	AimAxis<Flat> mixed(0.3);
+	long sum = total(mixed, 5, 10) + total(mixed, -2, 25);
+	CHECK(sum >= -1 && sum <= 1);  // 15 - 15, within the rounding of the last fraction
+
+	// Acceleration curve
+	CHECK(Accelerated::gain(0) == AimFixedOne);
+	CHECK(Accelerated::gain(4) == AimFixedOne);
+	CHECK(Accelerated::gain(6) == 2 * AimFixedOne);
+	CHECK(Accelerated::gain(31) == AimMaxGain);  // Capped
+	CHECK(Accelerated::gain(62) == Accelerated::gain(31));  // Past the table
+	for (uint8_t i = 1; i < Accelerated::Size; i++) {
+		CHECK(Accelerated::gain(i) >= Accelerated::gain(i - 1));
+	}
+
+	AimAxis<Accelerated> accel(1.0);
+	CHECK(accel.scale(4) == 4);
+	CHECK(accel.scale(6) == 12);
+	CHECK(accel.scale(-6) == -12);
+
+	// Largest input at the max gain and sensitivity doesn't overflow
+	AimAxis<Steepest> fastest(31.0);
+	CHECK(fastest.scale(62) == 62L * 8 * 31);
+	CHECK(fastest.scale(-62) == -62L * 8 * 31);
+
+	return CHECK_RESULT();
+}
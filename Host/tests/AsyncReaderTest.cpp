@@ -0,0 +1,120 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Staged controller reads against the simulated bus: how much of the read the loop
+// is blocked for, compared with the library's blocking update()
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Platforms.h"
+#include "DJLucio_LED.h"
+#include "DJLucio_HID.h"
+#include "DJLucio_Controller.h"
+
+using Host::Sim;
+
+const unsigned long OtherWork = 50;  // Loop time outside of the reader, per pass (us)
+
+ExtensionData data;
+ExtensionController controller(data);
+AsyncReader<TwoWire> reader(Wire, data);
+
+// Time for one blocking read (us)
+static unsigned long blockingRead() {
+	unsigned long start = Sim.now;
+	CHECK(controller.update());
+	return Sim.now - start;
+}
+
+// Runs one staged read with other work between the passes. Returns the time spent in
+// the reader (us), and the number of passes and the total time taken.
+static unsigned long stagedRead(unsigned int &passes, unsigned long &elapsed, AsyncReader<TwoWire>::Status &result) {
+	unsigned long start = Sim.now;
+	unsigned long blocked = 0;
+
+	unsigned long t = Sim.now;
+	CHECK(reader.start());
+	blocked += Sim.now - t;
+	passes = 1;
+
+	for (;;) {
+		Sim.advance(OtherWork);  // LED, config, HID...
+
+		t = Sim.now;
+		result = reader.update();
+		blocked += Sim.now - t;
+		passes++;
+
+		if (result != AsyncReader<TwoWire>::Status::Busy || passes > 100) { break; }
+	}
+
+	elapsed = Sim.now - start;
+	return blocked;
+}
+
+int main() {
+	Sim.plug(0, true);
+	Sim.controllers[0].set("rtt", 10);
+	controller.begin();
+
+	const uint32_t Clocks[] = { 100000, 400000 };
+	for (uint32_t clock : Clocks) {
+		Wire.setClock(clock);
+
+		unsigned long blocking = blockingRead();
+
+		memset(data.controlData, 0, sizeof(data.controlData));
+		unsigned int passes;
+		unsigned long elapsed;
+		AsyncReader<TwoWire>::Status result;
+		unsigned long staged = stagedRead(passes, elapsed, result);
+
+		CHECK(result == AsyncReader<TwoWire>::Status::Done);
+		CHECK(memcmp(data.controlData, Sim.controllers[0].data, 6) == 0);
+		CHECK(passes > 2);  // Spread across several loops
+		CHECK(staged < blocking);
+		CHECK(blocking - staged >= AsyncReader<TwoWire>::ConversionTime - OtherWork);  // At least the conversion wait is freed up
+
+		printf("AsyncReader @ %lu kHz: blocking read %lu us, staged read blocks %lu us over %u passes (%lu us total), saves %lu us per read\n",
+			(unsigned long) clock / 1000, blocking, staged, passes, elapsed, blocking - staged);
+	}
+
+	// Nobody there
+	Sim.plug(0, false);
+	CHECK(!reader.start());
+	CHECK(!reader.isBusy());
+
+	// Unplugged between the stages
+	Sim.plug(0, true);
+	CHECK(reader.start());
+	Sim.plug(0, false);
+	AsyncReader<TwoWire>::Status result = AsyncReader<TwoWire>::Status::Busy;
+	while (result == AsyncReader<TwoWire>::Status::Busy) {
+		Sim.advance(OtherWork);
+		result = reader.update();
+	}
+	CHECK(result == AsyncReader<TwoWire>::Status::Failed);
+	CHECK(!reader.isBusy());
+
+	return CHECK_RESULT();
+}
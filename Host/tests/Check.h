@@ -0,0 +1,34 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Minimal checks for the host tests. CHECK() prints the failing line and carries on,
+// CHECK_RESULT() prints a summary and gives the exit code for main().
+
+#ifndef Host_Check_h
+#define Host_Check_h
+
+#include <stdio.h>
+
+static unsigned int checkFailures = 0;
+
+#define CHECK(x) do { if (!(x)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); checkFailures++; } } while (0)
+#define CHECK_RESULT() (printf("%s: %s\n", __FILE__, checkFailures == 0 ? "PASS" : "FAIL"), checkFailures == 0 ? 0 : 1)
+
+#endif
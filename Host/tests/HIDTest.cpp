@@ -0,0 +1,105 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Key codes to keyboard reports: ASCII characters, shift, and modifier keys
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_HID.h"
+
+using Host::Sim;
+
+static bool keyDown(uint8_t usage) {
+	return (Sim.keys[usage / 8] >> (usage % 8)) & 1;
+}
+
+static bool shiftDown() {
+	return Sim.modifiers & 0x02;
+}
+
+KeyboardButton lower('a');
+KeyboardButton upper('A');
+KeyboardButton bang('!');
+KeyboardButton at('@');
+KeyboardButton minus('-');
+KeyboardButton slash('/');
+KeyboardButton backslash('\\');
+KeyboardButton tilde('~');
+KeyboardButton shift(KEY_LEFT_SHIFT);
+KeyboardButton unsupported(0x1B);  // Escape, not in the ASCII table
+
+int main() {
+	// Unshifted punctuation
+	minus.press();
+	CHECK(keyDown(0x2D) && !shiftDown());
+	minus.release();
+	slash.press();
+	backslash.press();
+	CHECK(keyDown(0x38) && keyDown(0x31) && !shiftDown());
+	slash.release();
+	backslash.release();
+
+	// Shifted characters hold shift with the key
+	upper.press();
+	CHECK(keyDown(0x04) && shiftDown());
+	upper.release();
+	CHECK(!keyDown(0x04) && !shiftDown());
+
+	tilde.press();
+	CHECK(keyDown(0x35) && shiftDown());
+	tilde.release();
+
+	// Shift stays down until the last shifted key is released
+	bang.press();
+	at.press();
+	CHECK(keyDown(0x1E) && keyDown(0x1F) && shiftDown());
+	bang.release();
+	CHECK(shiftDown());
+	at.release();
+	CHECK(!shiftDown());
+
+	// ... and doesn't release a shift key that's held on its own
+	shift.press();
+	upper.press();
+	upper.release();
+	CHECK(shiftDown());
+	shift.release();
+	CHECK(!shiftDown());
+
+	// Lowercase is unshifted
+	lower.press();
+	CHECK(keyDown(0x04) && !shiftDown());
+	lower.release();
+
+	// Unsupported keys send nothing
+	unsigned long reports = Sim.keyboardReports;
+	unsupported.press();
+	CHECK(Sim.keyboardReports == reports);
+
+	// Release all clears the shift count too
+	HID_Button::releaseAll();
+	upper.press();
+	HID_Button::releaseAll();
+	CHECK(!shiftDown() && !keyDown(0x04));
+
+	return CHECK_RESULT();
+}
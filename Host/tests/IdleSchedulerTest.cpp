@@ -0,0 +1,79 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Sleep decisions, driven by the times passed in rather than the clock
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Platforms.h"
+#include "DJLucio_LED.h"
+#include "DJLucio_HID.h"
+#include "DJLucio_Controller.h"
+
+using Host::Sim;
+
+// Returns 'true' if the scheduler slept at the end of this 'loop'
+static bool slept(unsigned long timeNow) {
+	unsigned long before = Sim.sleeps;
+	IdleScheduler::sleep(timeNow);
+	return Sim.sleeps != before;
+}
+
+int main() {
+	const unsigned long Wake = IdleScheduler::WakeTime;
+
+	// Nothing scheduled, don't sleep
+	CHECK(!slept(0));
+
+	// Deadline further away than the next interrupt
+	IdleScheduler::due(Wake + 100, 1000);
+	CHECK(slept(1000));
+
+	// ... but not if it's already close by the end of the loop
+	IdleScheduler::due(Wake + 100, 1000);
+	CHECK(!slept(1200));
+
+	// The earliest deadline wins
+	IdleScheduler::due(Wake * 4, 5000);
+	IdleScheduler::due(Wake / 2, 5000);
+	IdleScheduler::due(Wake * 2, 5000);
+	CHECK(!slept(5000));
+
+	// Busy overrides any deadline
+	IdleScheduler::due(Wake * 4, 5000);
+	IdleScheduler::busy();
+	CHECK(!slept(5000));
+
+	// Deadlines only last one loop
+	IdleScheduler::due(Wake * 4, 5000);
+	CHECK(slept(5000));
+	CHECK(!slept(5000));
+
+	// Across the micros() rollover
+	const unsigned long NearWrap = 0xFFFFFFFF - Wake;
+	IdleScheduler::due(Wake * 2, NearWrap);
+	CHECK(slept(NearWrap + 10));
+	IdleScheduler::due(Wake / 2, NearWrap);
+	CHECK(!slept(NearWrap + 10));
+
+	return CHECK_RESULT();
+}
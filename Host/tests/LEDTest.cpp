@@ -0,0 +1,73 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// LED blink patterns, timed from the loop's clock
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Platforms.h"
+#include "DJLucio_LED.h"
+
+using Host::Sim;
+
+static int ledLevel() {
+	return Sim.pinOutputs[LED_Pin] ^ LED_Inverted;
+}
+
+// Runs the LED for 'ms' loops, one per millisecond. Returns a bit for each level seen.
+static int run(unsigned long ms) {
+	int seen = 0;
+	for (unsigned long i = 0; i < ms; i++) {
+		Sim.advance(1000);
+		Frame.update();
+		LED.update(Frame);
+		seen |= 1 << ledLevel();
+	}
+	return seen;
+}
+
+int main() {
+	LED.begin();
+	LED.write(HIGH);
+	CHECK(ledLevel() == HIGH);
+
+	// millis() ticks over between the start of the loop and the blink
+	Sim.advance(5000);
+	Frame.update();
+	Sim.advance(1000);
+	LED.blink(10, 1200);
+	LED.update(Frame);
+	CHECK(run(1000) == 0x3);  // Still blinking
+
+	// ... and it stops when the time's up
+	run(250);
+	CHECK(run(100) == 1 << HIGH);
+
+	// Blinking forever
+	LED.blink(2);
+	CHECK(run(5000) == 0x3);
+	LED.stopBlinking();
+	CHECK(run(100) == 1 << HIGH);
+
+	return CHECK_RESULT();
+}
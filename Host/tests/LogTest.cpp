@@ -0,0 +1,91 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Debug log: records sent as binary and decoded on the host, back to the same text
+
+#define DEBUG
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Util.h"
+
+using Host::Sim;
+
+// Output from the log since the last call, decoded
+static std::string sent() {
+	DebugLog.flush();
+	std::string s = Sim.serialOut;
+	Sim.serialOut.clear();
+	return s;
+}
+
+int main() {
+	Sim.binaryLog = true;
+
+	DEBUG_PRINTLN("Hello");
+	CHECK(sent() == "Hello\r\n");
+
+	DEBUG_PRINT((int) -42);
+	DEBUG_PRINT(' ');
+	DEBUG_PRINT(4000000000UL);
+	DEBUG_PRINT(' ');
+	DEBUG_PRINT((long) -2147483647L - 1);
+	DEBUG_PRINT(' ');
+	DEBUG_PRINT((uint8_t) 255);
+	DEBUG_PRINT(' ');
+	DEBUG_PRINTHEX(0x0A);
+	DEBUG_PRINTHEX(0xF0);
+	DEBUG_PRINTLN();
+	CHECK(sent() == "-42 4000000000 -2147483648 255 0AF0\r\n");
+
+	// Strings longer than one write are sent over several updates
+	const char * Long = "A string that's longer than the logger's 32 byte write buffer, by a fair bit";
+	DEBUG_PRINTLN(Long);
+	unsigned int updates = 0;
+	size_t before = Sim.serialRaw.size();
+	while (Sim.serialOut.size() < strlen(Long) + 2 && updates < 10) {
+		DEBUG_UPDATE();
+		updates++;
+	}
+	CHECK(updates == 3);
+	CHECK(Sim.serialRaw.size() - before == 1 + strlen(Long) + 1 + 1);  // Type, string, terminator, newline
+	CHECK(sent() == std::string(Long) + "\r\n");
+
+	// Numbers are 5 bytes each, no matter how many digits
+	before = Sim.serialRaw.size();
+	DEBUG_PRINT(1234567UL);
+	sent();
+	CHECK(Sim.serialRaw.size() - before == 5);
+
+	// Queue overflow drops records and says how many
+	for (int i = 0; i < 100; i++) {
+		DEBUG_PRINT('x');
+	}
+	std::string s = sent();
+	CHECK(s == std::string(63, 'x') + "\r\nLOG: Dropped 37\r\n");
+
+	CHECK(!Sim.log.partial());
+	CHECK(Sim.log.errors == 0);
+
+	return CHECK_RESULT();
+}
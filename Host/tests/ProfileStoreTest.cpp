@@ -0,0 +1,147 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// EEPROM profile log: many saves to one profile, power loss partway through a
+// save, and sequence numbers wrapping around
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include <NintendoExtensionCtrl.h>
+#include "DJLucio_LED.h"
+#include "DJLucio_Performance.h"
+#include "DJLucio_ConfigMode.h"
+
+DJTurntableController::TurntableExpansion * mainTable = nullptr;
+DJTurntableController::TurntableExpansion * altTable = nullptr;
+
+// Storage in RAM, which can lose power after a number of byte writes
+class MemoryStorage {
+public:
+	MemoryStorage() { memset(bytes, 0xFF, sizeof(bytes)); }
+
+	template<class T> T & get(int address, T &t) {
+		memcpy(&t, bytes + address, sizeof(T));
+		return t;
+	}
+
+	template<class T> const T & put(int address, const T &t) {
+		const uint8_t * p = (const uint8_t *) &t;
+		for (size_t i = 0; i < sizeof(T); i++) {
+			if (writesLeft == 0) { return t; }  // Power's gone
+			if (writesLeft > 0) { writesLeft--; }
+			bytes[address + i] = p[i];
+		}
+		return t;
+	}
+
+	uint8_t bytes[1024];
+	long writesLeft = -1;  // Byte writes before the power drops, -1 for no limit
+};
+
+struct Profile {
+	uint8_t side;
+};
+
+const uint8_t NumProfiles = 8;
+typedef ProfileStore<Profile, NumProfiles, MemoryStorage> Store;
+
+// Starts a new store on the same memory, like a reboot
+static bool loads(MemoryStorage &memory, uint8_t id, uint8_t expected) {
+	Store store(memory);
+	store.begin();
+	Profile p;
+	return store.load(id, p) && p.side == expected;
+}
+
+int main() {
+	// Empty storage has nothing to load
+	{
+		MemoryStorage memory;
+		Store store(memory);
+		store.begin();
+		Profile p;
+		CHECK(!store.load(0, p));
+	}
+
+	// Saving one profile many times keeps the others
+	{
+		MemoryStorage memory;
+		Store store(memory);
+		store.begin();
+		for (uint8_t i = 0; i < NumProfiles; i++) {
+			store.save(i, Profile{ (uint8_t) (10 + i) });
+		}
+		for (int n = 0; n < 500; n++) {
+			store.save(3, Profile{ (uint8_t) n });
+		}
+		for (uint8_t i = 0; i < NumProfiles; i++) {
+			CHECK(loads(memory, i, i == 3 ? (uint8_t) 499 : 10 + i));
+		}
+	}
+
+	// Power loss at any byte of a save leaves every profile with its old or new value
+	for (long cut = 0; cut < 64; cut++) {
+		MemoryStorage memory;
+		{
+			Store store(memory);
+			store.begin();
+			for (uint8_t i = 0; i < NumProfiles; i++) {
+				store.save(i, Profile{ i });
+			}
+			for (int n = 0; n < 100 + cut; n++) {  // Different position in the log each time
+				store.save(n % 2, Profile{ (uint8_t) (n % 2) });
+			}
+			memory.writesLeft = cut;
+			store.save(0, Profile{ 100 });
+		}
+		memory.writesLeft = -1;
+
+		CHECK(loads(memory, 0, 0) || loads(memory, 0, 100));
+		for (uint8_t i = 1; i < NumProfiles; i++) {
+			CHECK(loads(memory, i, i));
+		}
+	}
+
+	// Random saves with reboots in between, past many sequence number wraps
+	{
+		MemoryStorage memory;
+		uint8_t expected[NumProfiles];
+		bool saved[NumProfiles] = {};
+		srand(1);
+		for (int boot = 0; boot < 50; boot++) {
+			Store store(memory);
+			store.begin();
+			for (int n = 0; n < 97; n++) {
+				uint8_t id = rand() % NumProfiles;
+				if (rand() % 4 != 0) { id = rand() % 2; }  // Mostly the first two
+				expected[id] = rand();
+				saved[id] = true;
+				store.save(id, Profile{ expected[id] });
+			}
+		}
+		for (uint8_t i = 0; i < NumProfiles; i++) {
+			CHECK(!saved[i] || loads(memory, i, expected[i]));
+		}
+	}
+
+	return CHECK_RESULT();
+}
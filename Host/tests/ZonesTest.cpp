@@ -0,0 +1,89 @@
+/*
+*  Project     DJ Hero - Lucio
+*  @author     David Madison
+*  @link       github.com/dmadison/DJHero-Lucio
+*  @license    GPLv3 - Copyright (c) 2018 David Madison
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Zones of an analog source: edges, hysteresis per edge, and dwell time
+
+#include "Simulator.h"
+#include "Check.h"
+
+#include <Arduino.h>
+#include "DJLucio_Platforms.h"
+#include "DJLucio_LED.h"
+#include "DJLucio_Mapping.h"
+
+using namespace Mapping;
+
+struct Input {
+	static uint8_t value() { return reading; }
+	static uint8_t reading;
+};
+
+uint8_t Input::reading = 0;
+
+// Left below 4, center, right from 10. Leaving the left zone is easy, leaving the right takes 3.
+typedef Zones<Input, 0, Edge<4>, Edge<10, 3>> Fader;
+typedef Zones<Input, 20, Edge<8, 1>> Slow;
+
+static uint8_t fader(uint8_t reading) {
+	Input::reading = reading;
+	return Fader::value();
+}
+
+int main() {
+	// Going up, each edge is the start of the next zone
+	CHECK(fader(0) == 0);
+	CHECK(fader(3) == 0);
+	CHECK(fader(4) == 1);
+	CHECK(fader(9) == 1);
+	CHECK(fader(10) == 2);
+
+	// Coming down from the right, it has to go 3 below the edge
+	CHECK(fader(8) == 2);
+	CHECK(fader(7) == 2);
+	CHECK(fader(6) == 1);
+
+	// The left edge has no hysteresis
+	CHECK(fader(3) == 0);
+	CHECK(fader(4) == 1);
+
+	// Jumping straight across both
+	CHECK(fader(15) == 2);
+	CHECK(fader(0) == 0);
+
+	// A new zone has to hold for the dwell time
+	Frame.ms = 1000;
+	Input::reading = 9;
+	CHECK(Slow::value() == 0);  // Counted from here
+	Frame.ms = 1019;
+	CHECK(Slow::value() == 0);
+	Frame.ms = 1020;
+	CHECK(Slow::value() == 1);
+
+	// Leaving goes past the hysteresis, then waits the dwell time too
+	Input::reading = 7;  // Inside the hysteresis
+	Frame.ms = 1030;
+	CHECK(Slow::value() == 1);
+	Input::reading = 6;
+	CHECK(Slow::value() == 1);  // Out, but waiting
+	Frame.ms = 1050;
+	CHECK(Slow::value() == 0);
+
+	return CHECK_RESULT();
+}